@@ -1,10 +1,13 @@
 #pragma once
 
+#include "picker.hpp"
+#include "table.hpp"
 #include "board.hpp"
 
 #include <optional>
 #include <cstddef>
 #include <future>
+#include <vector>
 
 namespace bcl {
     class ai {
@@ -12,14 +15,16 @@ namespace bcl {
             // All functions that take non-constant board references will utilise
             // the passed in board as a scratch area - however, all modifications
             // performed will be undone before returning.
-            ai(const std::size_t, const bool) noexcept;
+            // The transposition table is given a size in megabytes, and is kept between searches.
+            ai(const std::size_t, const bool, const std::size_t) noexcept;
 
             // Returns a floating-point number representing the advantage for a certain player.
             // Positive means an advantage for white, while negative means an advantage for black.
             double evaluate(board&) const noexcept;
 
             // Generates a legal move for the current board's player.
-            std::optional<move> generate(const board&) const noexcept;
+            // The search is done on the board passed in, so callers should pass a snapshot of their own.
+            std::optional<move> generate(board) const noexcept;
 
             // Returns the number of legal moves after n ply.
             std::size_t perft(const board&, const std::size_t) const noexcept;
@@ -34,7 +39,13 @@ namespace bcl {
             bool enabled;
 
         private:
-            // An implementation of the minimax algorithm.
-            double minimax(board&, double, double, const std::size_t, const piece::color) const noexcept;
+            template<typename R>
+            // An implementation of the minimax algorithm, for the board's ruleset.
+            // Killer moves are tracked per ply in a table owned by the caller, as is a running count
+            // of positions scored as draws by repetition (which depend on how they were reached).
+            double minimax(board&, double, double, const std::size_t, const piece::color, std::vector<killers>&, std::size_t&) const noexcept;
+
+            // Results of earlier searches, which can be written to by searches on any thread.
+            mutable table m_table;
     };
 }
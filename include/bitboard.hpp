@@ -0,0 +1,100 @@
+#pragma once
+
+#include "extras.hpp"
+#include "pieces.hpp"
+
+#include <initializer_list>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <bit>
+
+namespace bcl {
+    // A set of squares on an 8x8 board, where bit n corresponds to square n.
+    using bitboard = std::uint64_t;
+
+    namespace bitboards {
+        // The number of squares covered by a bitboard.
+        constexpr std::size_t squares = 64;
+
+        // The length of the board covered by a bitboard.
+        constexpr std::size_t length = 8;
+
+        // Returns a bitboard containing only the given square.
+        constexpr bitboard square(const std::size_t i) noexcept {
+            return bitboard {1} << i;
+        }
+
+        // Returns the index of the lowest square in a non-empty bitboard.
+        constexpr std::size_t first(const bitboard b) noexcept {
+            return static_cast<std::size_t>(std::countr_zero(b));
+        }
+
+        // Removes the lowest square from a non-empty bitboard and returns its index.
+        constexpr std::size_t pop(bitboard& b) noexcept {
+            std::size_t i = first(b);
+            b &= b - 1;
+            return i;
+        }
+
+        // Returns the number of squares in a bitboard.
+        constexpr std::size_t count(const bitboard b) noexcept {
+            return static_cast<std::size_t>(std::popcount(b));
+        }
+
+        // Returns a table of the squares reachable from each square via a fixed set of (rank, file) offsets.
+        consteval ext::array<bitboard, squares> leaper(const std::initializer_list<std::pair<int, int>> offsets) noexcept {
+            ext::array<bitboard, squares> table {};
+            constexpr int edge = static_cast<int>(length);
+
+            for(std::size_t i = 0; i < squares; ++i) {
+                for(const auto& [rank, file] : offsets) {
+                    int r = static_cast<int>(i / length) + rank;
+                    int f = static_cast<int>(i % length) + file;
+
+                    if(r >= 0 && r < edge && f >= 0 && f < edge) {
+                        table[i] |= square(static_cast<std::size_t>((r * edge) + f));
+                    }
+                }
+            }
+
+            return table;
+        }
+
+        // The squares attacked by a knight on each square.
+        inline constexpr auto knight = leaper({{+1, +2}, {+2, +1}, {+2, -1}, {+1, -2}, {-1, -2}, {-2, -1}, {-2, +1}, {-1, +2}});
+
+        // The squares attacked by a king on each square.
+        inline constexpr auto king = leaper({{+1, +0}, {+1, +1}, {+0, +1}, {-1, +1}, {-1, +0}, {-1, -1}, {+0, -1}, {+1, -1}});
+
+        // The squares attacked by a pawn on each square, indexed by color.
+        inline constexpr ext::array pawn = {
+            leaper({{+1, -1}, {+1, +1}}), // piece::color::white
+            leaper({{-1, -1}, {-1, +1}})  // piece::color::black
+        };
+
+        // Returns the squares attacked by a bishop, given the set of occupied squares.
+        // Sliding attacks are looked up from tables built once at startup, indexed
+        // with PEXT on CPUs that support BMI2 and with magic multiplication otherwise.
+        bitboard bishop(const std::size_t, const bitboard) noexcept;
+
+        // Returns the squares attacked by a rook, given the set of occupied squares.
+        bitboard rook(const std::size_t, const bitboard) noexcept;
+
+        // Returns the squares strictly between two squares on a common rank, file or diagonal.
+        // If the squares do not share a line, the result is empty.
+        bitboard between(const std::size_t, const std::size_t) noexcept;
+
+        // Returns every square on the rank, file or diagonal passing through two squares (including them).
+        // If the squares do not share a line, the result is empty.
+        bitboard line(const std::size_t, const std::size_t) noexcept;
+
+        // Returns whether sliding attacks are being indexed with PEXT.
+        bool accelerated(void) noexcept;
+
+        // Returns the squares attacked by a queen, given the set of occupied squares.
+        inline bitboard queen(const std::size_t i, const bitboard occupied) noexcept {
+            return bishop(i, occupied) | rook(i, occupied);
+        }
+    }
+}
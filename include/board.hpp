@@ -1,13 +1,21 @@
 #pragma once
 
+#include "bitboard.hpp"
+#include "geometry.hpp"
+#include "zobrist.hpp"
+#include "cache.hpp"
 #include "extras.hpp"
 #include "pieces.hpp"
 
-#include <centurion.hpp>
 #include <string_view>
+#include <cassert>
 #include <optional>
+#include <cstdint>
 #include <cstddef>
+#include <utility>
+#include <memory>
 #include <vector>
+#include <span>
 
 namespace bcl {
     using square = std::optional<piece>;
@@ -18,63 +26,328 @@ namespace bcl {
     struct pair : public ext::array<T, 2> {};
 
     struct rights {
-        bool kingside;
-        bool queenside;
+        bool kingside : 1;
+        bool queenside : 1;
     };
 
-    struct move {
-        std::size_t from;
-        std::size_t to;
+    // A move packed into 32 bits. The origin and destination squares take 8 bits each,
+    // followed by the kind of move and the piece that a pawn is promoted to (if any).
+    class move {
+        public:
+            // Left uninitialised, so that lists of moves can be created without clearing them first.
+            move(void) noexcept = default;
+
+            constexpr move(const std::size_t from, const std::size_t to, const piece::move kind = piece::move::normal, const piece::type promotion = piece::type::pawn) noexcept :
+                m_bits {static_cast<std::uint32_t>(from | (to << 8) | (std::size_t {ext::to_underlying(kind)} << 16) | (std::size_t {ext::to_underlying(promotion)} << 19))} {
+
+                assert(from < constants::maximum_squares && to < constants::maximum_squares);
+            }
+
+            // The square the piece is moved from.
+            constexpr std::size_t from(void) const noexcept {
+                return m_bits & 0xFF;
+            }
+
+            // The square the piece is moved to.
+            constexpr std::size_t to(void) const noexcept {
+                return (m_bits >> 8) & 0xFF;
+            }
+
+            // The kind of move, as worked out by the move generator.
+            constexpr piece::move kind(void) const noexcept {
+                return static_cast<piece::move>((m_bits >> 16) & 0x7);
+            }
+
+            // The piece a pawn is promoted to, which is only meaningful for promotions.
+            constexpr piece::type promotion(void) const noexcept {
+                return static_cast<piece::type>((m_bits >> 19) & 0x7);
+            }
+
+            // Returns whether the move neither captures nor promotes (castling counts as quiet).
+            constexpr bool quiet(void) const noexcept {
+                auto k = this->kind();
+                return k == piece::move::normal || k == piece::move::short_castle || k == piece::move::long_castle;
+            }
+
+            bool operator==(const move&) const noexcept = default;
+
+        private:
+            std::uint32_t m_bits;
     };
 
-    struct index {
-        std::size_t rank;
-        std::size_t file;
+    static_assert(constants::maximum_squares <= 256, "squares must fit into 8 bits of a move");
+    static_assert(ext::to_underlying(piece::move::last) < 8, "move kinds must fit into 3 bits of a move");
+    static_assert(ext::to_underlying(piece::type::last) < 8, "piece types must fit into 3 bits of a move");
+
+    namespace constants {
+        // An upper bound on the number of legal moves in a position, assuming each side has no more
+        // than two ranks' worth of pieces and every one of them moves like a queen in an empty board.
+        // Positions with more pieces than this allows for are rejected when they're loaded.
+        constexpr std::size_t maximum_moves = 2 * maximum_length * 4 * (maximum_length - 1);
+    }
+
+    // A fixed-capacity list of moves, stored inline so that generating moves never touches the heap.
+    class movelist {
+        public:
+            // The moves are deliberately left uninitialised, since only the first size() are ever read.
+            // Clearing the whole capacity on every construction would cost a memset at every node searched.
+            movelist(void) noexcept : m_size {0} {}
+
+            void push_back(const bcl::move m) noexcept {
+                assert(m_size < constants::maximum_moves);
+                m_moves[m_size++] = m;
+            }
+
+            void clear(void) noexcept {
+                m_size = 0;
+            }
+
+            std::size_t size(void) const noexcept {
+                return m_size;
+            }
+
+            bool empty(void) const noexcept {
+                return m_size == 0;
+            }
+
+            bcl::move* begin(void) noexcept {
+                return m_moves;
+            }
+
+            bcl::move* end(void) noexcept {
+                return m_moves + m_size;
+            }
+
+            const bcl::move* begin(void) const noexcept {
+                return m_moves;
+            }
+
+            const bcl::move* end(void) const noexcept {
+                return m_moves + m_size;
+            }
+
+            bcl::move& operator[](const std::size_t i) noexcept {
+                return m_moves[i];
+            }
+
+            const bcl::move& operator[](const std::size_t i) const noexcept {
+                return m_moves[i];
+            }
+
+        private:
+            bcl::move m_moves[constants::maximum_moves];
+            std::size_t m_size;
+    };
+
+    // Subsets of the legal moves that can be generated independently of each other.
+    enum class generation : unsigned char {
+        captures,   // Captures (including en passant) that don't promote.
+        promotions, // Pawn moves onto either end of the board, capturing or not.
+        quiets,     // Every other move, including castling.
+        all
     };
 
-    struct capture {
-        std::size_t index;
-        bcl::piece piece;
+    struct occupancy {
+        // The squares occupied by each color.
+        bcl::pair<bitboard> colors;
+
+        // The squares occupied by each type of piece.
+        ext::array<bitboard, ext::to_underlying(piece::type::last) + 1> types;
+
+        // Returns the squares occupied by any piece.
+        bitboard all(void) const noexcept {
+            return colors[piece::color::white] | colors[piece::color::black];
+        }
     };
 
+    // The squares occupied by each color and type of piece, kept as unordered lists so that
+    // pieces can be visited without scanning the whole board. Each square remembers its position
+    // within its list, which lets a piece be removed in constant time by swapping in the last one.
+    class roster {
+        public:
+            explicit roster(const std::size_t squares) noexcept : m_lists {}, m_slots(squares) {}
+
+            // Adds a piece standing on an empty square.
+            void insert(const std::size_t i, const piece p) noexcept {
+                auto& list = m_lists[p.hue][p.variety];
+                m_slots[i] = list.size();
+                list.push_back(i);
+            }
+
+            // Removes a piece from the square it stands on.
+            void erase(const std::size_t i, const piece p) noexcept {
+                auto& list = m_lists[p.hue][p.variety];
+                std::size_t slot = m_slots[i];
+                assert(list[slot] == i);
+
+                list[slot] = list.back();
+                m_slots[list[slot]] = slot;
+                list.pop_back();
+            }
+
+            // Returns the squares occupied by pieces of a given color and type, in no particular order.
+            std::span<const std::size_t> operator()(const piece::color c, const piece::type t) const noexcept {
+                return m_lists[c][t];
+            }
+
+        private:
+            bcl::pair<ext::array<std::vector<std::size_t>, ext::to_underlying(piece::type::last) + 1>> m_lists;
+            std::vector<std::size_t> m_slots;
+    };
+
+    template<typename S>
+    // Check and pin information for a position, kept for both colors so that it can be updated after a move.
+    // S is the type used to represent a set of squares (bitboards on 8x8 boards, square sets otherwise).
+    struct threats {
+        // The enemy pieces giving check to the side to move.
+        S checkers;
+
+        // The pieces of each color that are pinned to their own king.
+        pair<S> pinned;
+    };
+
+    // The state of the game, from the perspective of the player to move.
+    enum class status : unsigned char {
+        ongoing,
+        checkmate,
+        stalemate,
+        draw // By the 50 move rule.
+    };
+
+    // A breakdown of the positions counted by perft, by the last move made to reach each one.
+    struct tally {
+        std::size_t positions;
+        std::size_t captures;
+        std::size_t passants;
+        std::size_t castles;
+        std::size_t promotions;
+        std::size_t checks;
+
+        tally& operator+=(const tally& other) noexcept {
+            positions += other.positions;
+            captures += other.captures;
+            passants += other.passants;
+            castles += other.castles;
+            promotions += other.promotions;
+            checks += other.checks;
+            return *this;
+        }
+    };
+
+    // Everything needed to undo a move that can't be worked out from the move itself.
+    // The rook's move when castling and the square of a pawn captured en passant are
+    // implied by the kind of move, as is the piece that was moved when promoting.
     struct record {
-        piece::color color;
-        bcl::move move;
-        std::size_t trivials;
-        bcl::pair<bcl::rights> rights;
-        std::optional<bcl::move> castle;
-        std::optional<bcl::capture> capture;
-        std::optional<piece> promotion;
+        // The key of the position before the move.
+        zobrist::key hash {0};
+
+        // The move that was made.
+        bcl::move move {0, 0};
+
+        // The number of trivial half-moves made before the move.
+        std::uint16_t trivials {0};
+
+        // Castling rights for each player before the move.
+        bcl::pair<bcl::rights> rights {};
+
+        // The piece captured by the move (if any).
+        std::optional<piece> capture {};
+
+        // The color of the player who made the move.
+        piece::color color {piece::color::white};
     };
 
+    static_assert(sizeof(record) <= 24, "records should stay small, since one is pushed for every move made");
+
     class board {
         public:
+            // Boards of unsupported lengths can be created, but positions can't be loaded onto them.
             board(const std::size_t l, const bool a) noexcept :
                 length {l},
 
                 // Organised into bottom-left, top-left, bottom-right, top-right.
                 corners {0, length * (length - 1), length - 1, (length * length) - 1},
 
+                m_geometry {std::make_shared<const bcl::geometry>(l)},
                 m_internal {l * l},
-                m_anarchy {a} {}
-
-            // Attempts to move a piece from one square to another.
+                m_occupancy {(l == bitboards::length) ? std::optional(occupancy {}) : std::nullopt},
+                m_roster {(l != bitboards::length) ? std::optional(roster {l * l}) : std::nullopt},
+                m_bitboard_threats {},
+                m_mailbox_threats {},
+                m_kings {},
+                m_history {},
+                m_rights {},
+                m_anarchy {a},
+                m_color {piece::color::white},
+                m_trivials {0},
+                m_hash {0},
+                m_legal {},
+                m_status {} {}
+
+            // Attempts to move a piece from one square to another, promoting pawns to queens.
             bool move(const std::size_t, const std::size_t) noexcept;
 
+            // Plays a move produced by the move generator. The move is trusted to be
+            // legal in the current position, so none of the checks in move() are repeated.
+            void make(const bcl::move) noexcept;
+
+            template<typename R>
+            // Plays a move under a ruleset from rules.hpp, which must be the board's own. This is
+            // the same as make(), but without looking up the ruleset (or checking for any other).
+            void make(const bcl::move) noexcept;
+
             // Generates a list of all legal moves for the current player.
-            std::vector<bcl::move> moves(void) noexcept;
+            std::vector<bcl::move> moves(void) const noexcept;
+
+            // Appends a subset of the legal moves for the current player to a list.
+            // Anarchy mode has far more moves than fit in a list, so it isn't supported here.
+            void moves(movelist&, const generation) const noexcept;
 
             // An algorithm that counts possible positions recursively.
             std::size_t positions(const std::size_t) noexcept;
 
+            // Counts possible positions like positions() does, splitting the work between a number of threads.
+            // Each thread works on a copy of the board, taking the moves near the root one at a time.
+            // Subtrees are looked up in (and added to) the cache if one is given, which the threads share.
+            std::size_t positions(const std::size_t, const std::size_t, cache* = nullptr) const noexcept;
+
+            // Counts the positions reachable after each of the current player's moves (like positions() does),
+            // along with a breakdown of the last move made to reach them. Nothing is returned for depth 0.
+            std::vector<std::pair<bcl::move, tally>> divide(const std::size_t) noexcept;
+
             // Returns whether the player is currently in check.
             bool check(void) const noexcept;
 
+            // Returns whether a square is attacked by a given color. Sliders see through the transparent square (if any),
+            // which keeps a king from stepping back along the line of a piece checking it.
+            bool attacked(const std::size_t, const piece::color, const std::optional<std::size_t> = std::nullopt) const noexcept;
+
+            // Returns whether the piece on a square is pinned to its own king.
+            bool pinned(const std::size_t) const noexcept;
+
+            // Returns the number of pieces of a given color and type on the board.
+            std::size_t count(const piece::color, const piece::type) const noexcept;
+
+            // Returns whether the current position has already occurred a given number of times
+            // since the last irreversible move (so a threefold repetition is repeated(2)).
+            bool repeated(const std::size_t = 1) const noexcept;
+
+            // Returns the legal moves for the current player, which are only generated once per position.
+            // Anarchy mode has far more moves than fit in a list, so it isn't supported here.
+            const movelist& legal(void) const noexcept;
+
+            // Returns whether the current player has no legal moves. This stops at the first legal move it finds,
+            // trying the king first, so it costs far less than generating every move in most positions.
+            bool exhausted(void) const noexcept;
+
+            // Returns the state of the game, which is only worked out once per position.
+            bcl::status status(void) const noexcept;
+
             // Returns whether the player has been checkmated.
-            bool checkmate(void) noexcept;
+            bool checkmate(void) const noexcept;
 
             // Returns whether the player has been stalemated.
-            bool stalemate(void) noexcept;
+            bool stalemate(void) const noexcept;
 
             // Prints out the current board state to stdout.
             void print(void) const noexcept;
@@ -85,6 +358,14 @@ namespace bcl {
             // Undoes the last move.
             void undo(void) noexcept;
 
+            // Makes room for a number of moves to be made (and undone) without reallocating.
+            void reserve(const std::size_t) noexcept;
+
+            // Returns a copy of the board for searching on, which keeps only the history needed to detect
+            // repetitions (and en passant), with room for a number of moves to be made on top of it.
+            // Moves made before the copy was taken can't be undone on it.
+            board snapshot(const std::size_t = 0) const noexcept;
+
             // Returns a constant reference to the board's history array.
             const std::vector<record>& history(void) const noexcept {
                 return m_history;
@@ -95,33 +376,38 @@ namespace bcl {
                 return (!m_history.empty()) ? std::optional(m_history.back().move) : std::nullopt;
             }
 
+            // Returns whether the board is in anarchy mode, where piece movement rules don't apply.
+            bool anarchy(void) const noexcept {
+                return m_anarchy;
+            }
+
+            // Returns the Zobrist key of the current position, which covers piece placement,
+            // the player to move, castling rights and the file of a pawn that can be captured en passant.
+            zobrist::key hash(void) const noexcept {
+                return m_hash;
+            }
+
+            // Returns the number of trivial half-moves made, which forces a draw once it reaches 100.
+            std::size_t trivials(void) const noexcept {
+                return m_trivials;
+            }
+
             // Returns the color of the player whose turn it is to move.
             piece::color color(void) const noexcept {
                 return m_color;
             }
 
             // Provides support for range-based for loops.
-            std::vector<square>::iterator begin(void) noexcept {
-                return m_internal.begin();
-            }
-
+            // Squares are read-only, since the board keeps several representations in sync.
             std::vector<square>::const_iterator begin(void) const noexcept {
                 return m_internal.cbegin();
             }
 
-            std::vector<square>::iterator end(void) noexcept {
-                return m_internal.end();
-            }
-
             std::vector<square>::const_iterator end(void) const noexcept {
                 return m_internal.cend();
             }
 
             // Allow the use of array indexing syntax to access board squares.
-            square& operator[] (const std::size_t i) noexcept {
-                return m_internal[i];
-            }
-
             const square& operator[] (const std::size_t i) const noexcept {
                 return m_internal[i];
             }
@@ -133,12 +419,70 @@ namespace bcl {
             const ext::array<std::size_t, 4> corners;
 
         private:
-            // Returns the type of move (if pseudolegal) based on piece movement rules.
-            std::optional<piece::move> pseudolegal(const std::size_t, const std::size_t) const noexcept;
+            // Copies a board, keeping only a number of its most recent moves and making room for more.
+            board(const board&, const std::size_t, const std::size_t) noexcept;
+
+            // Returns the type of castling move (if allowed) for the king moving two squares along its rank,
+            // based on castling rights and the squares between the king and the rook. Attacks aren't considered.
+            std::optional<piece::move> castleable(const std::size_t, const std::size_t) const noexcept;
+
+            // Returns the move of the rook that accompanies a castling move.
+            bcl::move castling(const bcl::move) const noexcept;
+
+            // Returns whether any piece stands between two squares on a common rank, file or diagonal.
+            bool obstructed(const std::size_t, const std::size_t) const noexcept;
+
+            // Appends every legal move to a list, using the bitboards on 8x8 boards and the mailbox otherwise.
+            void bitboard_moves(movelist&, const generation) const noexcept;
+            void mailbox_moves(movelist&, const generation) const noexcept;
+
+            // Returns whether the current player has a legal move other than en passant or castling,
+            // using the bitboards on 8x8 boards and the mailbox otherwise.
+            bool bitboard_mobile(void) const noexcept;
+            bool mailbox_mobile(void) const noexcept;
+
+            // Returns the file of the pawn that just advanced two squares (if any).
+            std::optional<std::size_t> passant(void) const noexcept;
+
+            // Returns the part of the Zobrist key that doesn't depend on piece placement.
+            zobrist::key conditions(void) const noexcept;
+
+            // Computes the Zobrist key of the current position from scratch.
+            zobrist::key rehash(void) const noexcept;
+
+            // Places a piece on a square, replacing any piece already there.
+            void place(const std::size_t, const piece) noexcept;
+
+            // Removes the piece on a square (if present).
+            void clear(const std::size_t) noexcept;
+
+            // Moves the piece on one square to another, replacing any piece already there.
+            void shift(const std::size_t, const std::size_t) noexcept;
+
+            // Computes the threats in the current position from scratch and pushes them onto the threat stack.
+            void analyse(void) noexcept;
+
+            template<typename R>
+            // Pushes the threats in the current position onto the threat stack. If incremental, they're
+            // worked out from the threats before the last move, looking only at lines the move changed.
+            void analyse(const bool) noexcept;
+
+            // Lookup tables for the board's size, shared between copies of the board.
+            std::shared_ptr<const bcl::geometry> m_geometry;
 
             // The board's internal representation.
             std::vector<square> m_internal;
 
+            // Bitboards mirroring the internal representation, only maintained for 8x8 boards.
+            std::optional<occupancy> m_occupancy;
+
+            // Piece lists mirroring the internal representation, maintained for every other board.
+            std::optional<roster> m_roster;
+
+            // Threats for every position in the history (plus the current one), only one of which is used.
+            std::vector<threats<bitboard>> m_bitboard_threats;
+            std::vector<threats<squareset>> m_mailbox_threats;
+
             // A cache storing the position of checkable pieces.
             pair<std::size_t> m_kings;
 
@@ -156,13 +500,17 @@ namespace bcl {
 
             // The number of trivial half-moves made.
             std::size_t m_trivials;
+
+            // The Zobrist key of the current position, updated as pieces are placed and cleared.
+            zobrist::key m_hash;
+
+            // Caches for the current position, filled in on demand and cleared whenever the board changes.
+            mutable std::optional<movelist> m_legal;
+            mutable std::optional<bcl::status> m_status;
     };
 
     namespace constants {
         // The number of trivial half-moves until a forced draw.
         constexpr std::size_t trivial_force_draw = 100;
-
-        // The average position has about 40 legal moves.
-        constexpr std::size_t move_buffer_reserve = 40;
     }
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "zobrist.hpp"
+
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <atomic>
+
+namespace bcl {
+    // A table of the number of positions perft counts below each position, indexed by Zobrist key.
+    // It can be shared between threads without locking, since every entry is stored alongside its key
+    // XORed with its contents: an entry torn by two threads writing at once no longer matches any key.
+    class cache {
+        public:
+            // Creates a table using at most a number of bytes (but always at least one entry).
+            explicit cache(const std::size_t) noexcept;
+
+            // Returns the number of positions a number of ply below a position, if it has been stored.
+            std::optional<std::size_t> probe(const zobrist::key, const std::size_t) const noexcept;
+
+            // Stores the number of positions a number of ply below a position, replacing whatever was in its slot.
+            void store(const zobrist::key, const std::size_t, const std::size_t) noexcept;
+
+        private:
+            struct entry {
+                // The key of the position, XORed with the data.
+                std::atomic<std::uint64_t> check {0};
+
+                // The number of positions in the upper bits, and the depth in the lowest eight.
+                std::atomic<std::uint64_t> data {0};
+            };
+
+            std::unique_ptr<entry[]> m_entries;
+            std::size_t m_mask;
+    };
+}
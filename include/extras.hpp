@@ -34,22 +34,22 @@ namespace ext {
     class array : public std::array<T, N> {
         public:
             template<std::integral I>
-            const T& operator[](const I i) const noexcept {
+            constexpr const T& operator[](const I i) const noexcept {
                 return std::array<T, N>::operator[](i);
             }
 
             template<std::integral I>
-            T& operator[](const I i) noexcept {
+            constexpr T& operator[](const I i) noexcept {
                 return std::array<T, N>::operator[](i);
             }
 
             template<enumerable I>
-            const T& operator[](const I i) const noexcept {
+            constexpr const T& operator[](const I i) const noexcept {
                 return std::array<T, N>::operator[](to_underlying(i));
             }
 
             template<enumerable I>
-            T& operator[](const I i) noexcept {
+            constexpr T& operator[](const I i) noexcept {
                 return std::array<T, N>::operator[](to_underlying(i));
             }
     };
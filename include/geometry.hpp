@@ -0,0 +1,116 @@
+#pragma once
+
+#include "extras.hpp"
+#include "pieces.hpp"
+
+#include <optional>
+#include <cstddef>
+#include <bitset>
+#include <vector>
+#include <span>
+
+namespace bcl {
+    namespace constants {
+        // The smallest supported board length, which leaves room for both kings.
+        constexpr std::size_t minimum_length = 2;
+
+        // The largest supported board length, which bounds the size of fixed-capacity containers.
+        constexpr std::size_t maximum_length = 16;
+
+        // The number of squares on the largest supported board.
+        constexpr std::size_t maximum_squares = maximum_length * maximum_length;
+    }
+
+    // A set of squares on a board of any supported size, where bit n corresponds to square n.
+    using squareset = std::bitset<constants::maximum_squares>;
+
+    struct index {
+        std::size_t rank;
+        std::size_t file;
+    };
+
+    // Defines every direction a sliding piece can travel in.
+    // Orthogonal directions come first, followed by the diagonals.
+    enum class direction : unsigned char {
+        north,
+        east,
+        south,
+        west,
+        northeast,
+        southeast,
+        southwest,
+        northwest,
+        first = north,
+        last = northwest
+    };
+
+    // Returns whether a direction is diagonal (as opposed to orthogonal).
+    constexpr bool diagonal(const direction d) noexcept {
+        return d >= direction::northeast;
+    }
+
+    // Returns whether a piece type slides along a direction.
+    constexpr bool slides(const piece::type t, const direction d) noexcept {
+        return t == piece::type::queen || t == ((diagonal(d)) ? piece::type::bishop : piece::type::rook);
+    }
+
+    class geometry {
+        public:
+            // Precomputes the lookup tables for a board of the given length.
+            explicit geometry(const std::size_t) noexcept;
+
+            // The tables contain views into their own storage, so they cannot be copied.
+            geometry(const geometry&) = delete;
+            geometry& operator=(const geometry&) = delete;
+
+            // Returns the rank and file of a square.
+            const bcl::index& operator[](const std::size_t i) const noexcept {
+                return m_coordinates[i];
+            }
+
+            // Returns the squares a knight on a given square can jump to.
+            std::span<const std::size_t> knight(const std::size_t i) const noexcept {
+                return m_knights[i];
+            }
+
+            // Returns the squares a king on a given square can step to (excluding castling).
+            std::span<const std::size_t> king(const std::size_t i) const noexcept {
+                return m_kings[i];
+            }
+
+            // Returns the squares a pawn of a given color on a given square attacks.
+            std::span<const std::size_t> pawn(const piece::color c, const std::size_t i) const noexcept {
+                return m_pawns[c][i];
+            }
+
+            // Returns the direction leading from one square to another, if they share a line.
+            std::optional<direction> heading(const std::size_t, const std::size_t) const noexcept;
+
+            // Returns the squares along a ray from a given square, ordered from nearest to furthest.
+            std::span<const std::size_t> ray(const std::size_t i, const direction d) const noexcept {
+                return m_rays[(i * m_directions) + ext::to_underlying(d)];
+            }
+
+            // The length of the board.
+            const std::size_t length;
+
+            // The number of squares on the board.
+            const std::size_t squares;
+
+        private:
+            // The number of directions, used to index the ray table.
+            static constexpr std::size_t m_directions = ext::to_underlying(direction::last) + 1;
+
+            // The rank and file of every square.
+            std::vector<bcl::index> m_coordinates;
+
+            // Backing storage for every list of squares.
+            std::vector<std::size_t> m_storage;
+
+            // Per-square views into the backing storage.
+            std::vector<std::span<const std::size_t>> m_knights;
+            std::vector<std::span<const std::size_t>> m_kings;
+            ext::array<std::vector<std::span<const std::size_t>>, 2> m_pawns;
+            std::vector<std::span<const std::size_t>> m_rays;
+    };
+}
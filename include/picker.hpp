@@ -0,0 +1,133 @@
+#pragma once
+
+#include "extras.hpp"
+#include "board.hpp"
+
+#include <optional>
+#include <iterator>
+#include <cstddef>
+
+namespace bcl {
+    // The number of killer moves remembered for each ply of a search.
+    namespace constants {
+        constexpr std::size_t killer_slots = 2;
+    }
+
+    // Quiet moves that caused a beta cutoff at the same ply elsewhere in the tree.
+    using killers = ext::array<std::optional<move>, constants::killer_slots>;
+
+    // Yields the legal moves in a position one at a time, in the order that they are most
+    // likely to cause a cutoff. Later stages aren't generated until the earlier ones are exhausted,
+    // so a search that cuts off early never pays for generating (or sorting) the rest.
+    // The board must be in the same position whenever the picker is advanced.
+    class picker {
+        public:
+            // The stages that moves are picked in.
+            enum class stage : unsigned char {
+                hash,
+                captures,
+                winning,
+                promotions,
+                killer,
+                quiets,
+                losing,
+                done
+            };
+
+            class iterator {
+                public:
+                    using value_type = bcl::move;
+                    using difference_type = std::ptrdiff_t;
+
+                    explicit iterator(picker& p) noexcept : m_picker {&p} {}
+
+                    bcl::move operator*(void) const noexcept {
+                        return m_picker->m_current;
+                    }
+
+                    iterator& operator++(void) noexcept {
+                        m_picker->advance();
+                        return *this;
+                    }
+
+                    bool operator==(std::default_sentinel_t) const noexcept {
+                        return m_picker->m_stage == stage::done;
+                    }
+
+                private:
+                    picker* m_picker;
+            };
+
+            picker(const board& b, const std::optional<move> h, const bcl::killers& k) noexcept :
+                m_board {b},
+                m_hash {h},
+                m_killers {k},
+                m_current {},
+                m_stage {stage::hash},
+                m_index {0},
+                m_losing {0},
+                m_moves {},
+                m_segments {},
+                m_generated {} {}
+
+            // Starts picking moves. This can only be called once, since the picker is single-pass.
+            iterator begin(void) noexcept {
+                this->advance();
+                return iterator {*this};
+            }
+
+            std::default_sentinel_t end(void) const noexcept {
+                return {};
+            }
+
+            // Returns which kind of move a move would be in a position, or std::nullopt
+            // if the piece being moved can't be moved by the player whose turn it is.
+            static std::optional<generation> classify(const board&, const bcl::move) noexcept;
+
+        private:
+            // A range of indices into the move list.
+            struct segment {
+                std::size_t first;
+                std::size_t last;
+            };
+
+            // Moves on to the next move, generating further stages as required.
+            void advance(void) noexcept;
+
+            // Moves on to the next move in anarchy mode, where every move is quiet or a capture
+            // and there are too many to list, so they are enumerated on the fly instead.
+            void wander(void) noexcept;
+
+            // Returns whether a move is legal, by looking it up in the list of moves of the same kind.
+            bool legal(const bcl::move) noexcept;
+
+            // Returns where the moves of a given kind are stored in the move list, generating them if necessary.
+            segment list(const generation) noexcept;
+
+            // Returns whether a move has already been picked in an earlier stage.
+            bool picked(const bcl::move) const noexcept;
+
+            // Returns the value used to order captures, from most to least promising.
+            double score(const bcl::move) const noexcept;
+
+            // Returns whether a capture gives up more material than it wins to a defended square.
+            bool losing(const bcl::move) const noexcept;
+
+            const board& m_board;
+            std::optional<move> m_hash;
+            bcl::killers m_killers;
+
+            bcl::move m_current;
+            stage m_stage;
+
+            // The next move to consider in the current stage. Losing captures are moved
+            // to the end of the captures as they are found, starting from m_losing.
+            std::size_t m_index;
+            std::size_t m_losing;
+
+            // Every kind of move is generated into the same list, in whichever order they're needed.
+            bcl::movelist m_moves;
+            ext::array<segment, 3> m_segments;
+            ext::array<bool, 3> m_generated;
+    };
+}
@@ -66,6 +66,16 @@ namespace bcl {
             0.0  // piece::type::king
         };
 
+        // Letters for each piece type, as used by FEN strings and move notation.
+        constexpr ext::array piece_letters = {
+            'p', // piece::type::pawn
+            'n', // piece::type::knight
+            'b', // piece::type::bishop
+            'r', // piece::type::rook
+            'q', // piece::type::queen
+            'k'  // piece::type::king
+        };
+
         // Names for each piece color.
         constexpr ext::array color_titles = {
             "white", // piece::color::white
@@ -77,6 +87,11 @@ namespace bcl {
             "each piece type must have an associated value"
         );
 
+        static_assert(
+            piece_letters.size() == ext::to_underlying(piece::type::last) + 1,
+            "each piece type must have an associated letter"
+        );
+
         static_assert(
             color_titles.size() == ext::to_underlying(piece::color::last) + 1,
             "each piece color must have an associated name"
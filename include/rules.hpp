@@ -0,0 +1,75 @@
+#pragma once
+
+#include "board.hpp"
+
+#include <concepts>
+#include <cstddef>
+
+namespace bcl {
+    // Rulesets are chosen once (when the board is created) and passed around as template
+    // parameters, so that the code making and generating moves for one ruleset carries no
+    // checks for any other. Each ruleset provides a way of visiting every move for the current player.
+    namespace rules {
+        // The standard rules of chess.
+        struct standard {
+            // Calls a function with every legal move, which may make and undo moves on the board.
+            template<typename F>
+            static void each(const board& b, F&& f) noexcept {
+                bcl::movelist moves;
+                b.moves(moves, generation::all);
+
+                for(const auto& move : moves) {
+                    f(move);
+                }
+            }
+
+            // Returns the number of legal moves.
+            static std::size_t count(const board& b) noexcept {
+                bcl::movelist moves;
+                b.moves(moves, generation::all);
+                return moves.size();
+            }
+        };
+
+        // Anarchy mode, where any piece can move to any other square.
+        struct anarchy {
+            // Calls a function with every move, which may make and undo moves on the board.
+            // There are far too many moves to list, so the squares are walked through directly.
+            template<typename F>
+            static void each(const board& b, F&& f) noexcept {
+                std::size_t squares = b.length * b.length;
+
+                for(std::size_t from = 0; from < squares; ++from) {
+                    for(std::size_t to = 0; to < squares && b[from]; ++to) {
+                        if(from != to) {
+                            f(bcl::move {from, to, (b[to]) ? piece::move::capture : piece::move::normal});
+                        }
+                    }
+                }
+            }
+
+            // Returns the number of moves, which is every other square for every piece.
+            static std::size_t count(const board& b) noexcept {
+                std::size_t squares = b.length * b.length;
+                std::size_t pieces = 0;
+
+                for(const auto& square : b) {
+                    if(square) {
+                        ++pieces;
+                    }
+                }
+
+                return pieces * (squares - 1);
+            }
+        };
+    }
+
+    template<typename T>
+    concept ruleset = std::same_as<T, rules::standard> || std::same_as<T, rules::anarchy>;
+
+    template<typename F>
+    // Calls a function with an instance of the board's ruleset, as chosen when the board was created.
+    decltype(auto) dispatch(const board& b, F&& f) noexcept {
+        return (b.anarchy()) ? f(rules::anarchy {}) : f(rules::standard {});
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "zobrist.hpp"
+#include "board.hpp"
+
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <atomic>
+#include <array>
+
+namespace bcl {
+    // What a score stored in the transposition table says about the position's actual score.
+    enum class bound : unsigned char {
+        exact,
+        lower, // The search failed high, so the actual score is at least this.
+        upper  // The search failed low, so the actual score is at most this.
+    };
+
+    // The result of searching a position, as stored in the transposition table.
+    struct transposition {
+        double score;
+        std::size_t depth;
+        bcl::bound bound;
+        std::optional<bcl::move> move;
+    };
+
+    // A table of search results indexed by Zobrist key, which can be shared between threads without locking.
+    // Entries are grouped into buckets the size of a cache line, so probing a key only ever touches one line.
+    // Every entry is stored alongside its key XORed with its contents: an entry torn by two threads writing
+    // at once no longer matches any key, and is treated as missing.
+    class table {
+        public:
+            // Creates a table using at most a number of bytes (but always at least one bucket).
+            explicit table(const std::size_t) noexcept;
+
+            // Starts a new search, so that entries left over from earlier searches are replaced first.
+            void age(void) noexcept;
+
+            // Returns the result stored for a position (if any).
+            std::optional<transposition> probe(const zobrist::key) const noexcept;
+
+            // Stores the result of searching a position. An entry for the same position is always replaced,
+            // otherwise the entry in the bucket from the oldest search (or searched least deeply) makes way.
+            void store(const zobrist::key, const transposition&) noexcept;
+
+        private:
+            struct entry {
+                // The key of the position, XORed with the data.
+                std::atomic<std::uint64_t> check {0};
+
+                // The score, move, depth, bound and search generation, packed into 64 bits.
+                std::atomic<std::uint64_t> data {0};
+            };
+
+            struct alignas(64) bucket {
+                std::array<entry, 4> entries {};
+            };
+
+            static_assert(sizeof(bucket) == 64, "buckets should fill exactly one cache line");
+
+            std::unique_ptr<bucket[]> m_buckets;
+            std::size_t m_mask;
+            std::atomic<std::uint64_t> m_generation;
+    };
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "geometry.hpp"
+#include "pieces.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace bcl {
+    namespace zobrist {
+        // A key identifying a position, made by XORing together a random number for every feature of it.
+        // Keys are generated from a fixed seed, so the same position always has the same key.
+        using key = std::uint64_t;
+
+        // Returns the key for a piece standing on a square (of a board of any supported size).
+        key placement(const piece, const std::size_t) noexcept;
+
+        // Returns the key for a set of castling rights, packed into four bits in the order
+        // white kingside, white queenside, black kingside and black queenside.
+        key castling(const std::size_t) noexcept;
+
+        // Returns the key for a pawn that can be captured en passant on a given file.
+        key passant(const std::size_t) noexcept;
+
+        // Returns the key included whenever black is to move.
+        key turn(void) noexcept;
+    }
+}
@@ -1,4 +1,6 @@
+#include "picker.hpp"
 #include "extras.hpp"
+#include "rules.hpp"
 #include "ai.hpp"
 
 #include <fmt/core.h>
@@ -13,9 +15,9 @@ namespace detail {
     };
 }
 
-bcl::ai::ai(const std::size_t s, const bool e) noexcept : layers {s}, enabled {e} {
+bcl::ai::ai(const std::size_t s, const bool e, const std::size_t m) noexcept : layers {s}, future {}, enabled {e}, m_table {m * 1024 * 1024} {
     if(e) {
-        fmt::print("[bongcloud] AI enabled, search depth set to {} ply.\n", s);
+        fmt::print("[bongcloud] AI enabled, search depth set to {} ply with a {} MB transposition table.\n", s, m);
     }
 }
 
@@ -29,67 +31,147 @@ double bcl::ai::evaluate(bcl::board& board) const noexcept {
 
     double evaluation = 0.0;
 
-    for(const auto& piece : board) {
-        if(piece) {
-            auto value = constants::piece_values[piece->variety];
-            auto coefficient = detail::color_coefficients[piece->hue];
-            evaluation += coefficient * value;
+    for(auto hue = piece::color::first; hue <= piece::color::last; hue = hue + 1) {
+        for(auto variety = piece::type::first; variety <= piece::type::last; variety = variety + 1) {
+            auto value = constants::piece_values[variety];
+            auto coefficient = detail::color_coefficients[hue];
+            evaluation += coefficient * value * static_cast<double>(board.count(hue, variety));
         }
     }
 
     return evaluation;
 }
 
-std::optional<bcl::move> bcl::ai::generate(const bcl::board& board) const noexcept {
-    // Create a local copy so that we don't modify the passed in board
-    // and have the renderer go crazy trying to render the AI's moves.
-    bcl::board local = board;
-    std::vector<std::pair<move, double>> moves;
-    moves.reserve(constants::move_buffer_reserve);
-
-    for(const auto& move : local.moves()) {
-        // Make each move and then determine its score through the minimax algorithm.
-        local.move(move.from, move.to);
-        double inf = std::numeric_limits<double>::infinity();
-        double score = this->minimax(local, -inf, inf, layers, local.color());
-
-        auto pair = std::make_pair(move, score);
-        moves.push_back(pair);
-        local.undo();
-    }
+std::optional<bcl::move> bcl::ai::generate(bcl::board local) const noexcept {
+    // The root move and every layer below it are made on top of the current history.
+    // This costs nothing if the board was snapshotted with enough room already.
+    local.reserve(layers + 1);
 
-    if(moves.empty()) {
-        return std::nullopt;
-    }
+    // One set of killer moves for every ply below the root.
+    std::vector<bcl::killers> killers(layers + 1);
+    std::size_t repetitions = 0;
+
+    // Entries from earlier searches are kept for their moves, but are the first to be replaced.
+    m_table.age();
+
+    // White looks for the highest score and black for the lowest.
+    bool white = (local.color() == piece::color::white);
+    std::optional<std::pair<move, double>> best;
+
+    // The ruleset is fixed for the whole search, so it's only looked up once here.
+    bcl::dispatch(local, [&](auto policy) {
+        using R = decltype(policy);
+
+        auto consider = [&](const bcl::move move) {
+            // Make each move and then determine its score through the minimax algorithm.
+            local.make<R>(move);
+            double inf = std::numeric_limits<double>::infinity();
+            double score = this->minimax<R>(local, -inf, inf, layers, local.color(), killers, repetitions);
+            local.undo();
+
+            if(!best || (white && score > best->second) || (!white && score < best->second)) {
+                best = std::make_pair(move, score);
+            }
+        };
 
-    std::sort(moves.begin(), moves.end(), [](const auto& lhs, const auto& rhs) {
-        return lhs.second > rhs.second;
+        if constexpr(std::same_as<R, rules::anarchy>) {
+            for(const auto& move : bcl::picker {local, std::nullopt, {}}) {
+                consider(move);
+            }
+        }
+
+        else {
+            // Every root move is searched with a full window, so the order doesn't matter and the
+            // legal moves cached by the board can be used as they are. They're copied since making
+            // a move clears the cache.
+            auto moves = local.legal();
+
+            for(const auto& move : moves) {
+                consider(move);
+            }
+        }
     });
 
-    std::size_t index = (board.color() == piece::color::white) ? 0 : moves.size() - 1;
-    return moves[index].first;
+    if(!best) {
+        return std::nullopt;
+    }
+
+    return best->first;
 }
 
-double bcl::ai::minimax(bcl::board& board, double alpha, double beta, const std::size_t depth, const piece::color color) const noexcept {
+template<typename R>
+double bcl::ai::minimax(bcl::board& board, double alpha, double beta, const std::size_t depth, const piece::color color, std::vector<killers>& killers, std::size_t& repetitions) const noexcept {
+    // Repeating a position can't gain anything, so it's scored as a draw without searching any further.
+    if(board.repeated()) {
+        ++repetitions;
+        return 0.0;
+    }
+
     if(depth == 0) {
         return this->evaluate(board);
     }
 
+    // A position that has already been searched at least as deeply may not need searching again.
+    // Otherwise, the best move found for it last time is likely to still be the best, so it's tried first.
+    // The key leaves out the half-move clock, so positions the 50 move rule could cut short are skipped.
+    auto key = board.hash();
+    bool cacheable = board.trivials() + depth < constants::trivial_force_draw;
+    std::optional<transposition> entry;
+
+    if(cacheable) {
+        entry = m_table.probe(key);
+    }
+
+    if(entry && entry->depth >= depth) {
+        bool usable = {
+            entry->bound == bound::exact ||
+            (entry->bound == bound::lower && entry->score >= beta) ||
+            (entry->bound == bound::upper && entry->score <= alpha)
+        };
+
+        if(usable) {
+            return entry->score;
+        }
+    }
+
+    // The window is narrowed as moves are searched, but the bound stored depends on the original.
+    double initial_alpha = alpha;
+    double initial_beta = beta;
     double best;
     piece::color next;
+    std::optional<bcl::move> chosen;
+    std::size_t draws = repetitions;
+
+    // Moves are picked lazily, so a cutoff skips generating the remaining stages.
+    auto& slots = killers[depth];
+    bcl::picker picker {board, (entry) ? entry->move : std::nullopt, slots};
+
+    // Remember quiet moves that cause a cutoff, since they're likely to do so again at this ply.
+    // Moves are picked for the position they're made in, so the kind of move they carry can be trusted.
+    auto remember = [&](const bcl::move& move) {
+        if(move.quiet() && slots.front() != move) {
+            std::shift_right(slots.begin(), slots.end(), 1);
+            slots.front() = move;
+        }
+    };
 
     if(color == piece::color::white) {
         best = -std::numeric_limits<double>::infinity();
         next = piece::color::black;
 
-        for(const auto& move : board.moves()) {
-            board.move(move.from, move.to);
-            auto contender = this->minimax(board, alpha, beta, depth - 1, next);
-            best = std::max(best, contender);
+        for(const auto& move : picker) {
+            board.make<R>(move);
+            auto contender = this->minimax<R>(board, alpha, beta, depth - 1, next, killers, repetitions);
             board.undo();
 
+            if(contender > best) {
+                best = contender;
+                chosen = move;
+            }
+
             alpha = std::max(alpha, contender);
             if(beta <= alpha) {
+                remember(move);
                 break;
             }
         }
@@ -99,18 +181,30 @@ double bcl::ai::minimax(bcl::board& board, double alpha, double beta, const std:
         best = std::numeric_limits<double>::infinity();
         next = piece::color::white;
 
-        for(const auto& move : board.moves()) {
-            board.move(move.from, move.to);
-            auto contender = this->minimax(board, alpha, beta, depth - 1, next);
-            best = std::min(best, contender);
+        for(const auto& move : picker) {
+            board.make<R>(move);
+            auto contender = this->minimax<R>(board, alpha, beta, depth - 1, next, killers, repetitions);
             board.undo();
 
+            if(contender < best) {
+                best = contender;
+                chosen = move;
+            }
+
             beta = std::min(beta, contender);
             if(beta <= alpha) {
+                remember(move);
                 break;
             }
         }
     }
 
+    // A score that relied on a repetition somewhere below is only true for the path taken to get here,
+    // and the same position reached along a different path would wrongly inherit it, so it isn't stored.
+    if(cacheable && repetitions == draws) {
+        auto kind = (best <= initial_alpha) ? bound::upper : (best >= initial_beta) ? bound::lower : bound::exact;
+        m_table.store(key, {best, depth, kind, chosen});
+    }
+
     return best;
 }
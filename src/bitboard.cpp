@@ -0,0 +1,285 @@
+#include "bitboard.hpp"
+#include "extras.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__)
+    #include <immintrin.h>
+#endif
+
+namespace detail {
+    // A (rank, file) direction that a sliding piece can travel in.
+    struct direction {
+        int rank;
+        int file;
+    };
+
+    constexpr ext::array diagonals = {
+        direction {+1, +1}, direction {-1, +1}, direction {-1, -1}, direction {+1, -1}
+    };
+
+    constexpr ext::array orthogonals = {
+        direction {+1, +0}, direction {+0, +1}, direction {-1, +0}, direction {+0, -1}
+    };
+
+    // Walks from a square in a single direction, stopping at (and including) the first occupied square.
+    bcl::bitboard ray(const std::size_t from, const bcl::bitboard occupied, const direction d) noexcept {
+        constexpr int edge = static_cast<int>(bcl::bitboards::length);
+        bcl::bitboard attacks = 0;
+
+        int r = static_cast<int>(from / bcl::bitboards::length) + d.rank;
+        int f = static_cast<int>(from % bcl::bitboards::length) + d.file;
+
+        for(; r >= 0 && r < edge && f >= 0 && f < edge; r += d.rank, f += d.file) {
+            auto square = bcl::bitboards::square(static_cast<std::size_t>((r * edge) + f));
+            attacks |= square;
+
+            if(occupied & square) {
+                break;
+            }
+        }
+
+        return attacks;
+    }
+
+    // Returns the squares attacked from a square by walking along every given direction.
+    bcl::bitboard slide(const std::size_t from, const bcl::bitboard occupied, const ext::array<direction, 4>& directions) noexcept {
+        bcl::bitboard attacks = 0;
+
+        for(const auto& d : directions) {
+            attacks |= detail::ray(from, occupied, d);
+        }
+
+        return attacks;
+    }
+
+    // Returns the squares that can influence a slider's attacks from a square.
+    // Squares on the edge of the board are excluded since nothing lies behind them.
+    bcl::bitboard relevant(const std::size_t from, const ext::array<direction, 4>& directions) noexcept {
+        constexpr int edge = static_cast<int>(bcl::bitboards::length);
+        bcl::bitboard mask = 0;
+
+        for(const auto& d : directions) {
+            int r = static_cast<int>(from / bcl::bitboards::length) + d.rank;
+            int f = static_cast<int>(from % bcl::bitboards::length) + d.file;
+
+            // Only keep squares that have another square after them in the same direction.
+            for(; r + d.rank >= 0 && r + d.rank < edge && f + d.file >= 0 && f + d.file < edge; r += d.rank, f += d.file) {
+                mask |= bcl::bitboards::square(static_cast<std::size_t>((r * edge) + f));
+            }
+        }
+
+        return mask;
+    }
+
+    // Whether the CPU provides the BMI2 instruction set (and hence a fast PEXT).
+    bool bmi2(void) noexcept {
+        #if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+            return __builtin_cpu_supports("bmi2");
+        #else
+            return false;
+        #endif
+    }
+
+    #if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+        [[gnu::target("bmi2")]] std::uint64_t pext(const std::uint64_t value, const std::uint64_t mask) noexcept {
+            return _pext_u64(value, mask);
+        }
+    #else
+        std::uint64_t pext(const std::uint64_t value, const std::uint64_t mask) noexcept {
+            // Portable fallback, never selected at runtime but kept so the code compiles everywhere.
+            std::uint64_t result = 0;
+            for(std::uint64_t remaining = mask, bit = 1; remaining != 0; bit <<= 1, remaining &= remaining - 1) {
+                result |= (value & remaining & (~remaining + 1)) ? bit : 0;
+            }
+
+            return result;
+        }
+    #endif
+
+    // A deterministic xorshift generator, so that the magic search always finds the same numbers.
+    class xorshift {
+        public:
+            // Returns a random number with roughly an eighth of its bits set, which makes for better magics.
+            std::uint64_t sparse(void) noexcept {
+                return this->next() & this->next() & this->next();
+            }
+
+        private:
+            std::uint64_t next(void) noexcept {
+                m_state ^= m_state >> 12;
+                m_state ^= m_state << 25;
+                m_state ^= m_state >> 27;
+                return m_state * 2685821657736338717ULL;
+            }
+
+            std::uint64_t m_state = 1070372;
+    };
+
+    // The lookup parameters for a slider on a single square.
+    struct magic {
+        bcl::bitboard mask;
+        bcl::bitboard factor;
+        unsigned int shift;
+        std::size_t offset;
+    };
+
+    class slider {
+        public:
+            // Builds the attack tables for a slider moving along the given directions.
+            // If PEXT is available, the occupancy is compressed directly instead of hashed with a magic factor.
+            slider(const ext::array<direction, 4>& directions, const bool pext) noexcept : m_attacks {}, m_pext {pext} {
+                detail::xorshift random;
+                std::vector<bcl::bitboard> occupancies;
+                std::vector<bcl::bitboard> references;
+                std::vector<unsigned int> epochs;
+                unsigned int epoch = 0;
+
+                for(std::size_t i = 0; i < bcl::bitboards::squares; ++i) {
+                    auto& entry = m_magics[i];
+                    entry.mask = detail::relevant(i, directions);
+                    entry.shift = static_cast<unsigned int>(bcl::bitboards::squares - bcl::bitboards::count(entry.mask));
+                    entry.offset = m_attacks.size();
+
+                    // Enumerate every subset of the relevant squares using the Carry-Rippler trick.
+                    occupancies.clear();
+                    references.clear();
+                    bcl::bitboard subset = 0;
+
+                    do {
+                        occupancies.push_back(subset);
+                        references.push_back(detail::slide(i, subset, directions));
+                        subset = (subset - entry.mask) & entry.mask;
+                    } while(subset != 0);
+
+                    std::size_t size = occupancies.size();
+                    m_attacks.resize(entry.offset + size);
+                    epochs.assign(size, 0);
+
+                    if(m_pext) {
+                        for(std::size_t j = 0; j < size; ++j) {
+                            m_attacks[entry.offset + this->index(entry, occupancies[j])] = references[j];
+                        }
+
+                        continue;
+                    }
+
+                    // Keep trying candidate factors until one maps every subset without a destructive collision.
+                    for(bool found = false; !found;) {
+                        entry.factor = random.sparse();
+                        if(bcl::bitboards::count((entry.mask * entry.factor) >> 56) < 6) {
+                            continue;
+                        }
+
+                        found = true;
+                        ++epoch;
+
+                        for(std::size_t j = 0; j < size && found; ++j) {
+                            std::size_t k = this->index(entry, occupancies[j]);
+                            auto& slot = m_attacks[entry.offset + k];
+
+                            if(epochs[k] < epoch) {
+                                epochs[k] = epoch;
+                                slot = references[j];
+                            } else if(slot != references[j]) {
+                                found = false;
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Returns the squares attacked from a square, given the set of occupied squares.
+            bcl::bitboard operator()(const std::size_t i, const bcl::bitboard occupied) const noexcept {
+                const auto& entry = m_magics[i];
+                return m_attacks[entry.offset + this->index(entry, occupied)];
+            }
+
+        private:
+            std::size_t index(const magic& entry, const bcl::bitboard occupied) const noexcept {
+                if(m_pext) {
+                    return static_cast<std::size_t>(detail::pext(occupied, entry.mask));
+                }
+
+                return static_cast<std::size_t>(((occupied & entry.mask) * entry.factor) >> entry.shift);
+            }
+
+            ext::array<magic, bcl::bitboards::squares> m_magics {};
+            std::vector<bcl::bitboard> m_attacks;
+            bool m_pext;
+    };
+
+    // Returns a table of the squares strictly between every pair of squares on a common line.
+    ext::array<ext::array<bcl::bitboard, bcl::bitboards::squares>, bcl::bitboards::squares> spans(void) noexcept {
+        ext::array<ext::array<bcl::bitboard, bcl::bitboards::squares>, bcl::bitboards::squares> table {};
+        constexpr int edge = static_cast<int>(bcl::bitboards::length);
+
+        for(std::size_t i = 0; i < bcl::bitboards::squares; ++i) {
+            for(const auto& directions : {diagonals, orthogonals}) {
+                for(const auto& d : directions) {
+                    int r = static_cast<int>(i / bcl::bitboards::length) + d.rank;
+                    int f = static_cast<int>(i % bcl::bitboards::length) + d.file;
+                    bcl::bitboard trail = 0;
+
+                    for(; r >= 0 && r < edge && f >= 0 && f < edge; r += d.rank, f += d.file) {
+                        auto j = static_cast<std::size_t>((r * edge) + f);
+                        table[i][j] = trail;
+                        trail |= bcl::bitboards::square(j);
+                    }
+                }
+            }
+        }
+
+        return table;
+    }
+
+    // Returns a table of the full lines (edge to edge) passing through every pair of squares on a common line.
+    ext::array<ext::array<bcl::bitboard, bcl::bitboards::squares>, bcl::bitboards::squares> lines(void) noexcept {
+        ext::array<ext::array<bcl::bitboard, bcl::bitboards::squares>, bcl::bitboards::squares> table {};
+
+        for(std::size_t i = 0; i < bcl::bitboards::squares; ++i) {
+            for(const auto& directions : {diagonals, orthogonals}) {
+                // Directions are stored so that opposite directions are two elements apart.
+                for(std::size_t d = 0; d < directions.size(); ++d) {
+                    auto forwards = detail::ray(i, 0, directions[d]);
+                    auto backwards = detail::ray(i, 0, directions[(d + 2) % directions.size()]);
+                    auto line = forwards | backwards | bcl::bitboards::square(i);
+
+                    for(bcl::bitboard b = forwards; b;) {
+                        table[i][bcl::bitboards::pop(b)] = line;
+                    }
+                }
+            }
+        }
+
+        return table;
+    }
+
+    // The attack tables are built once during static initialisation, before main() runs.
+    const bool accelerated = detail::bmi2();
+    const slider bishops {diagonals, accelerated};
+    const slider rooks {orthogonals, accelerated};
+    const auto between = detail::spans();
+    const auto line = detail::lines();
+}
+
+bcl::bitboard bcl::bitboards::bishop(const std::size_t i, const bitboard occupied) noexcept {
+    return detail::bishops(i, occupied);
+}
+
+bcl::bitboard bcl::bitboards::rook(const std::size_t i, const bitboard occupied) noexcept {
+    return detail::rooks(i, occupied);
+}
+
+bcl::bitboard bcl::bitboards::between(const std::size_t a, const std::size_t b) noexcept {
+    return detail::between[a][b];
+}
+
+bcl::bitboard bcl::bitboards::line(const std::size_t a, const std::size_t b) noexcept {
+    return detail::line[a][b];
+}
+
+bool bcl::bitboards::accelerated(void) noexcept {
+    return detail::accelerated;
+}
@@ -1,261 +1,452 @@
+#include "geometry.hpp"
 #include "pieces.hpp"
 #include "extras.hpp"
+#include "rules.hpp"
 #include "board.hpp"
 
-#include <centurion.hpp>
 #include <fmt/core.h>
 #include <algorithm>
 #include <stdexcept>
 #include <charconv>
+#include <utility>
 #include <cassert>
+#include <atomic>
+#include <future>
 #include <cctype>
+#include <span>
 
 namespace detail {
-    std::size_t perft(bcl::board& board, const std::size_t depth) noexcept {
+    template<bcl::ruleset R>
+    std::size_t perft(bcl::board& board, const std::size_t depth, bcl::cache* cache) noexcept {
         if(depth == 0) {
             return 1;
         }
 
+        // The moves one ply away only need counting, not making.
+        if(depth == 1) {
+            return R::count(board);
+        }
+
+        // A position's subtree only depends on its key, unless the 50 move rule could cut it short.
+        bool cacheable = cache && board.trivials() + depth < bcl::constants::trivial_force_draw;
+
+        if(cacheable) {
+            if(auto count = cache->probe(board.hash(), depth)) {
+                return *count;
+            }
+        }
+
         std::size_t count = 0;
-        for(const auto& move : board.moves()) {
-            board.move(move.from, move.to);
-            count += perft(board, depth - 1);
+
+        R::each(board, [&](const bcl::move move) {
+            board.make<R>(move);
+            count += perft<R>(board, depth - 1, cache);
             board.undo();
+        });
+
+        if(cacheable) {
+            cache->store(board.hash(), depth, count);
         }
 
         return count;
     }
+
+    // Tallies the positions reachable a number of ply after the position just reached by a move.
+    // Every leaf has to be made, since telling whether it gives check needs the position itself.
+    template<bcl::ruleset R>
+    bcl::tally tally(bcl::board& board, const std::size_t depth) noexcept {
+        bcl::tally tally {};
+
+        if(depth == 0) {
+            const auto& last = board.history().back();
+            auto kind = last.move.kind();
+
+            tally.positions = 1;
+            tally.captures = (last.capture) ? 1 : 0;
+            tally.passants = (kind == bcl::piece::move::en_passant) ? 1 : 0;
+            tally.castles = (kind == bcl::piece::move::short_castle || kind == bcl::piece::move::long_castle) ? 1 : 0;
+            tally.promotions = (kind == bcl::piece::move::promotion) ? 1 : 0;
+            tally.checks = (board.check()) ? 1 : 0;
+            return tally;
+        }
+
+        R::each(board, [&](const bcl::move move) {
+            board.make<R>(move);
+            tally += detail::tally<R>(board, depth - 1);
+            board.undo();
+        });
+
+        return tally;
+    }
+}
+
+void bcl::board::place(const std::size_t square, const piece p) noexcept {
+    this->clear(square);
+    m_internal[square] = p;
+    m_hash ^= zobrist::placement(p, square);
+
+    if(m_occupancy) {
+        auto bit = bitboards::square(square);
+        m_occupancy->colors[p.hue] |= bit;
+        m_occupancy->types[p.variety] |= bit;
+    } else {
+        m_roster->insert(square, p);
+    }
+}
+
+void bcl::board::clear(const std::size_t square) noexcept {
+    auto& occupant = m_internal[square];
+
+    if(occupant && m_occupancy) {
+        auto bit = bitboards::square(square);
+        m_occupancy->colors[occupant->hue] &= ~bit;
+        m_occupancy->types[occupant->variety] &= ~bit;
+    } else if(occupant) {
+        m_roster->erase(square, *occupant);
+    }
+
+    if(occupant) {
+        m_hash ^= zobrist::placement(*occupant, square);
+    }
+
+    occupant = std::nullopt;
+}
+
+void bcl::board::shift(const std::size_t from, const std::size_t to) noexcept {
+    auto p = *m_internal[from];
+    this->clear(from);
+    this->place(to, p);
 }
 
 bool bcl::board::move(const std::size_t from, const std::size_t to) noexcept {
-    auto& origin = m_internal[from];
-    auto& dest = m_internal[to];
+    const auto& dest = m_internal[to];
 
-    assert(origin.has_value());
+    assert(m_internal[from].has_value());
     assert(from != to);
 
     if(m_anarchy) {
         // Anarchy mode is limited to normal moves and capturing moves,
         // since regular piece movement rules do not apply.
-        bcl::record ffa;
-        ffa.color = m_color;
-        ffa.move = {from, to};
-        ffa.trivials = m_trivials;
+        this->make<rules::anarchy>({from, to, (dest) ? piece::move::capture : piece::move::normal});
+        return true;
+    }
+
+    // Otherwise, the move has to be one of the legal moves, which are cached between calls.
+    // Pawns reaching the end of the board are always promoted to queens here.
+    const auto& moves = this->legal();
+
+    auto match = std::find_if(moves.begin(), moves.end(), [&](const bcl::move m) {
+        bool queening = m.kind() != piece::move::promotion || m.promotion() == piece::type::queen;
+        return m.from() == from && m.to() == to && queening;
+    });
+
+    if(match == moves.end()) {
+        return false;
+    }
+
+    this->make<rules::standard>(*match);
+    return true;
+}
+
+bcl::move bcl::board::castling(const bcl::move move) const noexcept {
+    // We can use the king's position as an anchor and perform arithmetic relative to it.
+    std::size_t edge = move.from() - (*m_geometry)[move.from()].file;
+
+    if(move.kind() == piece::move::short_castle) {
+        return {edge + length - 1, move.to() - 1};
+    }
+
+    return {edge, move.to() + 1};
+}
+
+template<typename R>
+void bcl::board::make(const bcl::move move) noexcept {
+    constexpr bool anarchy = std::same_as<R, rules::anarchy>;
+    assert(m_anarchy == anarchy);
+
+    std::size_t from = move.from();
+    std::size_t to = move.to();
+    const auto& origin = m_internal[from];
+    const auto& dest = m_internal[to];
+
+    assert(origin.has_value());
+    assert(from != to);
 
-        if(dest) {
-            ffa.capture = {to, *dest};
+    bcl::record history;
+    history.hash = m_hash;
+    history.move = move;
+    history.trivials = static_cast<std::uint16_t>(std::min(m_trivials, constants::trivial_force_draw));
+    history.rights = m_rights;
+    history.capture = dest;
+    history.color = m_color;
+
+    // Pieces update the key as they're placed and cleared, but everything else is swapped out wholesale.
+    m_hash ^= this->conditions();
+    m_legal.reset();
+    m_status.reset();
+
+    if constexpr(anarchy) {
+        // Nothing but the pieces themselves changes in anarchy mode.
+        this->shift(from, to);
+        m_history.push_back(history);
+        m_hash ^= this->conditions();
+        assert(m_hash == this->rehash());
+        this->analyse<R>(true);
+        return;
+    }
+
+    // Moving a rook off its corner (or capturing one on it) gives up castling on that side, while
+    // moving the king (which includes castling) gives up castling on both. Each color's left corner
+    // is on the queenside and its right corner on the kingside.
+    for(auto hue : {piece::color::white, piece::color::black}) {
+        if(from == corners[hue] || to == corners[hue]) {
+            m_rights[hue].queenside = false;
         }
 
-        dest = origin;
-        origin = std::nullopt;
-        m_history.push_back(ffa);
-        return true;
+        if(from == corners[hue + 2] || to == corners[hue + 2]) {
+            m_rights[hue].kingside = false;
+        }
     }
 
-    // First, make sure that there are no trivial conditions preventing a move.
-    // This could be either a forced stalemate (50 move rule), attempting to
-    // move an enemy piece or attempting to capture a friendly piece.
-    if(m_trivials >= constants::trivial_force_draw || origin->hue != m_color || (dest && dest->hue == m_color)) {
-        return false;
+    if(origin->variety == piece::type::king) {
+        m_rights[origin->hue].kingside = false;
+        m_rights[origin->hue].queenside = false;
     }
 
-    // Otherwise, check if the move is pseudolegal and move the pieces accordingly.
-    if(auto type = this->pseudolegal(from, to)) {
-        bcl::record history;
-        history.color = m_color;
-        history.move = {from, to};
-        history.trivials = m_trivials;
-        history.rights = m_rights;
-
-        switch(*type) {
-            case piece::move::normal: {
-                if(origin->variety == piece::type::rook) {
-                    if(from == 0 || from == length * (length - 1)) {
-                        m_rights[origin->hue].kingside = false;
-                    } else if(from == length - 1 || from == (length * length) - 1) {
-                        m_rights[origin->hue].queenside = false;
-                    }
-                }
+    switch(move.kind()) {
+        case piece::move::normal:
+        case piece::move::capture: {
+            break;
+        }
 
-                else if(origin->variety == piece::type::king) {
-                    m_rights[origin->hue].kingside = false;
-                    m_rights[origin->hue].queenside = false;
-                }
+        case piece::move::en_passant: {
+            const auto& latest = this->latest();
+            history.capture = m_internal[latest->to()];
+            this->clear(latest->to());
+            break;
+        }
 
-                break;
-            }
+        case piece::move::short_castle:
+        case piece::move::long_castle: {
+            // The king is moved by the common code below, so only the rook is moved here.
+            auto rook = this->castling(move);
+            this->shift(rook.from(), rook.to());
+            break;
+        }
 
-            case piece::move::capture: {
-                if(origin->variety == piece::type::rook) {
-                    if(from == 0 || from == length * (length - 1)) {
-                        m_rights[origin->hue].kingside = false;
-                    } else if(from == length - 1 || from == (length * length) - 1) {
-                        m_rights[origin->hue].queenside = false;
-                    }
-                }
+        case piece::move::promotion: {
+            // Instead of placing a promoted piece immediately,
+            // we can use the common piece movement code and just set
+            // the origin square to contain the promoted piece.
+            this->place(from, piece {origin->hue, move.promotion()});
+            break;
+        }
+    }
 
-                else if(origin->variety == piece::type::king) {
-                    m_rights[origin->hue].kingside = false;
-                    m_rights[origin->hue].queenside = false;
-                }
+    // Every move involves the same sequence of copying the piece
+    // from the origin square to the destination square and then
+    // clearing the origin square and incrementing the move count.
+    this->shift(from, to);
+    m_history.push_back(std::move(history));
 
-                history.capture = {to, *dest};
-                break;
-            }
+    if(dest->variety == piece::type::king) {
+        m_kings[dest->hue] = to;
+    }
 
-            case piece::move::en_passant: {
-                const auto& latest = this->latest();
-                auto& target = m_internal[latest->to];
-                history.capture = {latest->to, *target};
-                target = std::nullopt;
-                break;
-            }
+    bool trivial = dest->variety != piece::type::pawn && move.kind() == piece::move::normal;
+    m_trivials = (trivial) ? m_trivials + 1 : 0;
 
-            case piece::move::short_castle: {
-                // Since this has already been validated and confirmed to be pseudolegal,
-                // we can use the king's position as an anchor and perform arithmetic relative to it.
-                history.castle = {((from / length) * length) + length - 1, to - 1};
+    // Hand the turn over and work out the threats in the new position.
+    m_color = ext::flip(m_color);
+    m_hash ^= this->conditions();
+    assert(m_hash == this->rehash());
+    this->analyse<R>(true);
+}
 
-                // If the king is already in check, we cannot castle.
-                if(this->check()) {
-                    return false;
-                }
+template void bcl::board::make<bcl::rules::standard>(const bcl::move) noexcept;
+template void bcl::board::make<bcl::rules::anarchy>(const bcl::move) noexcept;
 
-                // Check that the king isn't moving through check.
-                // We don't have to worry about accidental captures here.
-                for(std::size_t delta = 1; delta < to - from; ++delta) {
-                    auto& trail = m_internal[from + delta - 1];
-                    auto& cursor = m_internal[from + delta];
-                    m_kings[origin->hue] = from + delta;
-                    cursor = trail;
-                    trail = std::nullopt;
-
-                    if(this->check()) {
-                        m_kings[origin->hue] = from;
-                        origin = cursor;
-                        cursor = std::nullopt;
-                        return false;
-                    }
-                }
+void bcl::board::make(const bcl::move move) noexcept {
+    bcl::dispatch(*this, [&](auto policy) {
+        this->make<decltype(policy)>(move);
+    });
+}
 
-                // Since the king is now on the rook's destination square,
-                // we move the king back to its original square before moving the rook.
-                auto& rook = m_internal[history.castle->from];
-                auto& king = m_internal[history.castle->to];
-                m_rights[origin->hue].kingside = false;
-                origin = king;
-                king = rook;
-                rook = std::nullopt;
-                break;
-            }
+std::optional<std::size_t> bcl::board::passant(void) const noexcept {
+    const auto& latest = this->latest();
+    if(!latest) {
+        return std::nullopt;
+    }
 
-            case piece::move::long_castle: {
-                // Since this has already been validated and confirmed to be pseudolegal,
-                // we can use the king's position as an anchor and perform arithmetic relative to it.
-                history.castle = {(from / length) * length, to + 1};
+    const auto& mover = m_internal[latest->to()];
+    std::size_t distance = (latest->from() > latest->to()) ? latest->from() - latest->to() : latest->to() - latest->from();
 
-                // If the king is already in check, we cannot castle.
-                if(this->check()) {
-                    return false;
-                }
+    if(mover && mover->variety == piece::type::pawn && distance == length * 2) {
+        return (*m_geometry)[latest->to()].file;
+    }
 
-                // Check that the king isn't moving through check.
-                // We don't have to worry about accidental captures here.
-                for(std::size_t delta = 1; delta < from - to; ++delta) {
-                    auto& trail = m_internal[from - delta + 1];
-                    auto& cursor = m_internal[from - delta];
-                    m_kings[origin->hue] = from - delta;
-                    cursor = trail;
-                    trail = std::nullopt;
-
-                    if(this->check()) {
-                        m_kings[origin->hue] = from;
-                        origin = cursor;
-                        cursor = std::nullopt;
-                        return false;
-                    }
-                }
+    return std::nullopt;
+}
 
-                // Since the king is now on the rook's destination square,
-                // we move the king to its proper destination before moving the rook.
-                auto& rook = m_internal[history.castle->from];
-                auto& king = m_internal[history.castle->to];
-                m_rights[origin->hue].queenside = false;
-                origin = king;
-                king = rook;
-                rook = std::nullopt;
-                break;
-            }
+bcl::zobrist::key bcl::board::conditions(void) const noexcept {
+    using color = piece::color;
+
+    std::size_t rights = {
+        (std::size_t {m_rights[color::white].kingside} << 0) |
+        (std::size_t {m_rights[color::white].queenside} << 1) |
+        (std::size_t {m_rights[color::black].kingside} << 2) |
+        (std::size_t {m_rights[color::black].queenside} << 3)
+    };
+
+    zobrist::key key = zobrist::castling(rights);
+
+    if(m_color == color::black) {
+        key ^= zobrist::turn();
+    }
+
+    if(auto file = this->passant()) {
+        key ^= zobrist::passant(*file);
+    }
+
+    return key;
+}
+
+bcl::zobrist::key bcl::board::rehash(void) const noexcept {
+    zobrist::key key = this->conditions();
 
-            case piece::move::promotion: {
-                if(dest) {
-                    history.capture = {to, *dest};
+    for(std::size_t i = 0; i < m_internal.size(); ++i) {
+        if(const auto& piece = m_internal[i]) {
+            key ^= zobrist::placement(*piece, i);
+        }
+    }
+
+    return key;
+}
+
+std::size_t bcl::board::positions(const std::size_t depth) noexcept {
+    this->reserve(depth);
+
+    return bcl::dispatch(*this, [&](auto policy) {
+        return detail::perft<decltype(policy)>(*this, depth, nullptr);
+    });
+}
+
+std::size_t bcl::board::positions(const std::size_t depth, const std::size_t threads, bcl::cache* cache) const noexcept {
+    return bcl::dispatch(*this, [&](auto policy) {
+        using R = decltype(policy);
+
+        if(threads <= 1 || depth <= 1) {
+            auto local = this->snapshot(depth);
+            return detail::perft<R>(local, depth, cache);
+        }
+
+        // The work is handed out as the moves leading from the root to some position. Moves are split a ply deeper
+        // while there are too few of them to go around, so that no thread is left idle once the others finish.
+        std::vector<std::vector<bcl::move>> tasks {{}};
+        std::size_t split = 0;
+        auto scratch = this->snapshot(depth);
+
+        while(split + 1 < depth && tasks.size() < threads * 8) {
+            std::vector<std::vector<bcl::move>> deeper;
+
+            for(const auto& path : tasks) {
+                for(const auto& move : path) {
+                    scratch.make<R>(move);
                 }
 
-                // Instead of placing a promoted piece immediately,
-                // we can use the common piece movement code and just set
-                // the origin square to contain the promoted piece.
-                origin = piece {origin->hue, piece::type::queen};
-                history.promotion = origin;
-                break;
+                R::each(scratch, [&](const bcl::move move) {
+                    deeper.push_back(path);
+                    deeper.back().push_back(move);
+                });
+
+                for(std::size_t i = 0; i < path.size(); ++i) {
+                    scratch.undo();
+                }
             }
+
+            tasks = std::move(deeper);
+            ++split;
         }
 
-        // Every move involves the same sequence of copying the piece
-        // from the origin square to the destination square and then
-        // clearing the origin square and incrementing the move count.
-        dest = origin;
-        origin = std::nullopt;
-        m_history.push_back(std::move(history));
+        // Threads take the next task whenever they finish one, which balances the
+        // work between them even though some moves lead to far more positions than others.
+        std::atomic<std::size_t> next = 0;
+        std::vector<std::future<std::size_t>> workers;
 
-        if(dest->variety == piece::type::king) {
-            m_kings[origin->hue] = to;
-        }
+        for(std::size_t i = 0; i < std::min(threads, tasks.size()); ++i) {
+            auto worker = [&, local = this->snapshot(depth)]() mutable {
+                std::size_t count = 0;
 
-        // Check that the move just played did not leave the king in check.
-        if(this->check()) {
-            this->undo();
-            return false;
+                for(std::size_t task = next++; task < tasks.size(); task = next++) {
+                    for(const auto& move : tasks[task]) {
+                        local.make<R>(move);
+                    }
+
+                    count += detail::perft<R>(local, depth - split, cache);
+
+                    for(std::size_t j = 0; j < tasks[task].size(); ++j) {
+                        local.undo();
+                    }
+                }
+
+                return count;
+            };
+
+            workers.push_back(std::async(std::launch::async, std::move(worker)));
         }
 
-        // Otherwise, finalise the state of the board.
-        bool trivial = dest->variety != piece::type::pawn && type == piece::move::normal;
-        m_trivials = (trivial) ? m_trivials + 1 : 0;
-        m_color = ext::flip(m_color);
-        return true;
-    };
+        std::size_t count = 0;
+        for(auto& worker : workers) {
+            count += worker.get();
+        }
 
-    return false;
+        return count;
+    });
 }
 
-std::vector<bcl::move> bcl::board::moves(void) noexcept {
-    // Preallocate space here so we don't spend time resizing and copying.
-    std::vector<bcl::move> moves;
-    moves.reserve(constants::move_buffer_reserve);
-
-    for(std::size_t from = 0; from < length * length; ++from) {
-        for(std::size_t to = 0; to < length * length; ++to) {
-            if(from != to && m_internal[from] && this->move(from, to)) {
-                bcl::move m = {from, to};
-                moves.push_back(m);
-                this->undo();
-            }
-        }
+std::vector<std::pair<bcl::move, bcl::tally>> bcl::board::divide(const std::size_t depth) noexcept {
+    // No moves are made at depth 0, so there's nothing to break down.
+    std::vector<std::pair<bcl::move, bcl::tally>> subtotals;
+    if(depth == 0) {
+        return subtotals;
     }
 
-    return moves;
+    this->reserve(depth);
+
+    bcl::dispatch(*this, [&](auto policy) {
+        using R = decltype(policy);
+
+        R::each(*this, [&](const bcl::move move) {
+            this->make<R>(move);
+            subtotals.emplace_back(move, detail::tally<R>(*this, depth - 1));
+            this->undo();
+        });
+    });
+
+    return subtotals;
 }
 
-std::size_t bcl::board::positions(const std::size_t depth) noexcept {
-    return detail::perft(*this, depth);
+std::size_t bcl::board::count(const piece::color color, const piece::type type) const noexcept {
+    if(m_occupancy) {
+        return bitboards::count(m_occupancy->colors[color] & m_occupancy->types[type]);
+    }
+
+    return (*m_roster)(color, type).size();
 }
 
-bool bcl::board::check(void) const noexcept {
-    std::size_t king = m_kings[m_color];
+bool bcl::board::repeated(const std::size_t times) const noexcept {
+    // Positions don't repeat in any meaningful way when pieces can move anywhere.
+    if(m_anarchy) {
+        return false;
+    }
+
+    // Nothing before the last capture, pawn move or castle can recur, and
+    // only every other position has the same player to move as this one.
+    std::size_t span = std::min(m_trivials, m_history.size());
+    std::size_t count = 0;
 
-    for(std::size_t i = 0; i < length * length; ++i) {
-        const auto& piece = m_internal[i];
-        if(piece && piece->hue != m_color && this->pseudolegal(i, king)) {
+    for(std::size_t back = 2; back <= span; back += 2) {
+        if(m_history[m_history.size() - back].hash == m_hash && ++count >= times) {
             return true;
         }
     }
@@ -263,12 +454,66 @@ bool bcl::board::check(void) const noexcept {
     return false;
 }
 
-bool bcl::board::checkmate(void) noexcept {
-    return this->check() && this->moves().empty();
+const bcl::movelist& bcl::board::legal(void) const noexcept {
+    assert(!m_anarchy);
+
+    if(!m_legal) {
+        m_legal.emplace();
+        this->moves(*m_legal, generation::all);
+    }
+
+    return *m_legal;
 }
 
-bool bcl::board::stalemate(void) noexcept {
-    return this->moves().empty() && !this->check();
+bcl::status bcl::board::status(void) const noexcept {
+    if(!m_status) {
+        // The move generator doesn't produce any moves once the 50 move rule
+        // has come into effect, so that has to be checked for first.
+        if(!m_anarchy && m_trivials >= constants::trivial_force_draw) {
+            m_status = bcl::status::draw;
+        } else if(this->exhausted()) {
+            m_status = (this->check()) ? bcl::status::checkmate : bcl::status::stalemate;
+        } else {
+            m_status = bcl::status::ongoing;
+        }
+    }
+
+    return *m_status;
+}
+
+bool bcl::board::checkmate(void) const noexcept {
+    return this->status() == bcl::status::checkmate;
+}
+
+bool bcl::board::stalemate(void) const noexcept {
+    return this->status() == bcl::status::stalemate;
+}
+
+bool bcl::board::exhausted(void) const noexcept {
+    if(m_anarchy) {
+        // Any piece on the board can move in anarchy mode.
+        return std::none_of(m_internal.begin(), m_internal.end(), [](const square& s) {
+            return s.has_value();
+        });
+    }
+
+    // The legal moves might already have been generated.
+    if(m_legal) {
+        return m_legal->empty();
+    }
+
+    // No moves can be made once the game has been drawn by the 50 move rule.
+    if(m_trivials >= constants::trivial_force_draw) {
+        return true;
+    }
+
+    if((m_occupancy) ? this->bitboard_mobile() : this->mailbox_mobile()) {
+        return false;
+    }
+
+    // Castling is never the only legal move, since the king must be able to step onto the square
+    // it crosses. En passant can be, but that's rare enough to leave to the full move generator.
+    return this->legal().empty();
 }
 
 void bcl::board::print(void) const noexcept {
@@ -327,6 +572,12 @@ void bcl::board::load(const std::string_view string) {
     using color = bcl::piece::color;
     using type = bcl::piece::type;
 
+    // Squares have to fit into 8 bits of a move and into fixed-size square sets.
+    if(length < constants::minimum_length || length > constants::maximum_length) {
+        auto comment = fmt::format("unsupported board size: {} (must be between {} and {})", length, constants::minimum_length, constants::maximum_length);
+        throw std::runtime_error(comment);
+    }
+
     // FEN strings start with piece placement from the top-left square.
     std::size_t character = 0;
     std::size_t rank = length - 1;
@@ -341,40 +592,40 @@ void bcl::board::load(const std::string_view string) {
 
         switch(c) {
             // Uppercase represents white pieces, lowercase represents black pieces.
-            case 'R': m_internal[square] = piece {color::white, type::rook}; break;
-            case 'N': m_internal[square] = piece {color::white, type::knight}; break;
-            case 'B': m_internal[square] = piece {color::white, type::bishop}; break;
-            case 'Q': m_internal[square] = piece {color::white, type::queen}; break;
+            case 'R': this->place(square, piece {color::white, type::rook}); break;
+            case 'N': this->place(square, piece {color::white, type::knight}); break;
+            case 'B': this->place(square, piece {color::white, type::bishop}); break;
+            case 'Q': this->place(square, piece {color::white, type::queen}); break;
 
             case 'K': {
                 if(royals[color::white]) {
                     throw std::runtime_error("multiple kings are forbidden");
                 }
 
-                m_internal[square] = piece {color::white, type::king};
+                this->place(square, piece {color::white, type::king});
                 m_kings[color::white] = square;
                 royals[color::white] = true;
                 break;
             }
 
-            case 'P': m_internal[square] = piece {color::white, type::pawn}; break;
-            case 'r': m_internal[square] = piece {color::black, type::rook}; break;
-            case 'n': m_internal[square] = piece {color::black, type::knight}; break;
-            case 'b': m_internal[square] = piece {color::black, type::bishop}; break;
-            case 'q': m_internal[square] = piece {color::black, type::queen}; break;
+            case 'P': this->place(square, piece {color::white, type::pawn}); break;
+            case 'r': this->place(square, piece {color::black, type::rook}); break;
+            case 'n': this->place(square, piece {color::black, type::knight}); break;
+            case 'b': this->place(square, piece {color::black, type::bishop}); break;
+            case 'q': this->place(square, piece {color::black, type::queen}); break;
 
             case 'k': {
                 if(royals[color::black]) {
                     throw std::runtime_error("multiple kings are forbidden");
                 }
 
-                m_internal[square] = piece {color::black, type::king};
+                this->place(square, piece {color::black, type::king});
                 m_kings[color::black] = square;
                 royals[color::black] = true;
                 break;
             }
 
-            case 'p': m_internal[square] = piece {color::black, type::pawn}; break;
+            case 'p': this->place(square, piece {color::black, type::pawn}); break;
 
             // Numbers signify the number of squares to skip.
             case '1': case '2': case '3':
@@ -400,6 +651,24 @@ void bcl::board::load(const std::string_view string) {
         }
     }
 
+    // Moves are generated into a movelist of fixed capacity, so reject positions that could ever overflow it.
+    // No piece has more moves than a queen (or a pawn with three ways to promote), and a side never gains pieces.
+    if(!m_anarchy) {
+        std::size_t reach = std::max(4 * (length - 1), 3 * constants::promotion_pieces.size());
+        pair<std::size_t> pieces = {0, 0};
+
+        for(const auto& square : m_internal) {
+            if(square) {
+                ++pieces[square->hue];
+            }
+        }
+
+        if(std::max(pieces[color::white], pieces[color::black]) * reach > constants::maximum_moves) {
+            auto comment = fmt::format("too many pieces for a {}x{} board: {} and {}", length, length, pieces[color::white], pieces[color::black]);
+            throw std::runtime_error(comment);
+        }
+    }
+
     // Next, assign the specified active color.
     switch((c = string.at(character++))) {
         case 'w': m_color = color::white; break;
@@ -447,7 +716,10 @@ void bcl::board::load(const std::string_view string) {
         // which could be impossible to capture en passant on.
 
         record latest;
-        latest.trivials = m_trivials;
+        latest.hash = 0;
+        latest.trivials = 0;
+        latest.rights = m_rights;
+        latest.color = ext::flip(m_color);
 
         latest.move = {
             (m_color == color::white) ? capture_square + length : capture_square - length,
@@ -460,38 +732,112 @@ void bcl::board::load(const std::string_view string) {
     // Handle the half-move clock via string-to-integer conversion.
     // The full-move count is not handled explicitly as we have no use for it.
     std::from_chars(string.begin() + character, string.end(), m_trivials);
+    m_hash = this->rehash();
+    m_legal.reset();
+    m_status.reset();
+
+    // Every record in the history has an associated set of threats, plus one for the current position.
+    m_bitboard_threats.clear();
+    m_mailbox_threats.clear();
+
+    for(std::size_t i = 0; i <= m_history.size(); ++i) {
+        this->analyse();
+    }
 }
 
 void bcl::board::undo(void) noexcept {
     assert(!m_history.empty());
 
     const auto& last = m_history.back();
-    auto& origin = m_internal[last.move.from];
-    auto& dest = m_internal[last.move.to];
+    const auto& grid = *m_geometry;
+    std::size_t from = last.move.from();
+    std::size_t to = last.move.to();
+    auto kind = last.move.kind();
 
     // If the move was a promotion, then we don't care about what's on the destination square.
-    origin = (last.promotion) ? piece {last.promotion->hue, piece::type::pawn} : dest;
-    dest = std::nullopt;
+    auto moved = (kind == piece::move::promotion) ? piece {last.color, piece::type::pawn} : *m_internal[to];
+    this->clear(to);
+    this->place(from, moved);
 
-    if(origin->variety == piece::type::king) {
-        m_kings[origin->hue] = last.move.from;
+    if(moved.variety == piece::type::king) {
+        m_kings[moved.hue] = from;
     }
 
     if(last.capture) {
-        // This is separate because of the possibility of en-passant.
-        auto& capture = m_internal[last.capture->index];
-        capture = last.capture->piece;
+        // Pawns captured en passant stand beside the origin square rather than on the destination.
+        std::size_t square = (kind == piece::move::en_passant) ? (grid[from].rank * length) + grid[to].file : to;
+        this->place(square, *last.capture);
     }
 
-    if(last.castle) {
-        auto& source = m_internal[last.castle->from];
-        auto& sink = m_internal[last.castle->to];
-        source = sink;
-        sink = std::nullopt;
+    if(kind == piece::move::short_castle || kind == piece::move::long_castle) {
+        auto rook = this->castling(last.move);
+        this->shift(rook.to(), rook.from());
     }
 
     m_rights = last.rights;
     m_color = last.color;
     m_trivials = last.trivials;
+    m_hash = last.hash;
     m_history.pop_back();
+    m_legal.reset();
+    m_status.reset();
+    assert(m_hash == this->rehash());
+
+    if(m_occupancy) {
+        m_bitboard_threats.pop_back();
+    } else {
+        m_mailbox_threats.pop_back();
+    }
+}
+
+bcl::board::board(const board& other, const std::size_t kept, const std::size_t room) noexcept :
+    length {other.length},
+    corners {other.corners},
+    m_geometry {other.m_geometry},
+    m_internal {other.m_internal},
+    m_occupancy {other.m_occupancy},
+    m_roster {other.m_roster},
+    m_bitboard_threats {},
+    m_mailbox_threats {},
+    m_kings {other.m_kings},
+    m_history {},
+    m_rights {other.m_rights},
+    m_anarchy {other.m_anarchy},
+    m_color {other.m_color},
+    m_trivials {other.m_trivials},
+    m_hash {other.m_hash},
+    m_legal {other.m_legal},
+    m_status {other.m_status} {
+
+    assert(kept <= other.m_history.size());
+    m_history.reserve(kept + room);
+    m_history.assign(other.m_history.end() - static_cast<std::ptrdiff_t>(kept), other.m_history.end());
+
+    // Each record has its own threats, plus one set for the current position.
+    auto tail = [&](auto& into, const auto& from) {
+        if(!from.empty()) {
+            into.reserve(kept + room + 1);
+            into.assign(from.end() - static_cast<std::ptrdiff_t>(kept + 1), from.end());
+        }
+    };
+
+    tail(m_bitboard_threats, other.m_bitboard_threats);
+    tail(m_mailbox_threats, other.m_mailbox_threats);
+}
+
+bcl::board bcl::board::snapshot(const std::size_t room) const noexcept {
+    // Nothing before the last irreversible move can be repeated, but the latest move
+    // is always kept since it's needed to tell whether a pawn can be captured en passant.
+    std::size_t kept = std::min(std::max(m_trivials, std::size_t {1}), m_history.size());
+    return board {*this, kept, room};
+}
+
+void bcl::board::reserve(const std::size_t n) noexcept {
+    m_history.reserve(m_history.size() + n);
+
+    if(m_occupancy) {
+        m_bitboard_threats.reserve(m_bitboard_threats.size() + n);
+    } else {
+        m_mailbox_threats.reserve(m_mailbox_threats.size() + n);
+    }
 }
@@ -0,0 +1,38 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace detail {
+    constexpr std::uint64_t depth_bits = 8;
+    constexpr std::uint64_t depth_mask = (std::uint64_t {1} << depth_bits) - 1;
+
+    // Returns the number of entries that fit in a number of bytes. A power of
+    // two is always used, so that a key can be turned into an index with a mask.
+    std::size_t entries(const std::size_t bytes, const std::size_t size) noexcept {
+        return std::bit_floor(std::max(bytes / size, std::size_t {1}));
+    }
+}
+
+bcl::cache::cache(const std::size_t bytes) noexcept :
+    m_entries {std::make_unique<entry[]>(detail::entries(bytes, sizeof(entry)))},
+    m_mask {detail::entries(bytes, sizeof(entry)) - 1} {}
+
+std::optional<std::size_t> bcl::cache::probe(const zobrist::key key, const std::size_t depth) const noexcept {
+    const auto& slot = m_entries[key & m_mask];
+    std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+    std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+    if((check ^ data) != key || (data & detail::depth_mask) != depth) {
+        return std::nullopt;
+    }
+
+    return static_cast<std::size_t>(data >> detail::depth_bits);
+}
+
+void bcl::cache::store(const zobrist::key key, const std::size_t depth, const std::size_t count) noexcept {
+    auto& slot = m_entries[key & m_mask];
+    std::uint64_t data = (static_cast<std::uint64_t>(count) << detail::depth_bits) | (depth & detail::depth_mask);
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+}
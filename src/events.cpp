@@ -3,7 +3,6 @@
 #include <fmt/core.h>
 #include <cstddef>
 #include <future>
-#include <chrono>
 
 bcl::event_dispatcher::event_dispatcher(board& b, ai& e, renderer& r) noexcept :
     m_board {b},
@@ -43,10 +42,10 @@ void bcl::event_dispatcher::on_keyboard_event(const cen::keyboard_event& event)
 }
 
 void bcl::event_dispatcher::on_mouse_button_event(const cen::mouse_button_event& event) noexcept {
-    using namespace std::chrono_literals;
-
     if(event.pressed() && event.button() == cen::mouse_button::left) {
-        if(!m_engine.future.valid() || m_engine.future.wait_for(0ms) == std::future_status::ready) {
+        // The board is left alone until the engine's move has been made (not just found), since
+        // the move was searched on a snapshot and is made without being checked against the board.
+        if(!m_engine.future.valid()) {
             auto x = static_cast<std::size_t>(event.x());
             auto y = static_cast<std::size_t>(event.y());
             auto i = m_renderer.square(m_board, x, y);
@@ -0,0 +1,147 @@
+#include "geometry.hpp"
+#include "extras.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace detail {
+    // A displacement measured in ranks and files.
+    struct delta {
+        int rank;
+        int file;
+    };
+
+    constexpr ext::array knight_deltas = {
+        delta {+1, +2}, delta {+2, +1}, delta {+2, -1}, delta {+1, -2},
+        delta {-1, -2}, delta {-2, -1}, delta {-2, +1}, delta {-1, +2}
+    };
+
+    // Ordered in the same way as the direction enum.
+    constexpr ext::array direction_deltas = {
+        delta {+1, +0}, // bcl::direction::north
+        delta {+0, +1}, // bcl::direction::east
+        delta {-1, +0}, // bcl::direction::south
+        delta {+0, -1}, // bcl::direction::west
+        delta {+1, +1}, // bcl::direction::northeast
+        delta {-1, +1}, // bcl::direction::southeast
+        delta {-1, -1}, // bcl::direction::southwest
+        delta {+1, -1}  // bcl::direction::northwest
+    };
+
+    constexpr ext::array pawn_deltas = {
+        ext::array {delta {+1, -1}, delta {+1, +1}}, // bcl::piece::color::white
+        ext::array {delta {-1, -1}, delta {-1, +1}}  // bcl::piece::color::black
+    };
+
+    static_assert(
+        direction_deltas.size() == ext::to_underlying(bcl::direction::last) + 1,
+        "each direction must have an associated delta"
+    );
+}
+
+bcl::geometry::geometry(const std::size_t l) noexcept :
+    length {l},
+    squares {l * l},
+    m_coordinates {},
+    m_storage {},
+    m_knights {},
+    m_kings {},
+    m_pawns {},
+    m_rays {} {
+
+    // Lists are first recorded as (offset, size) pairs, since the backing
+    // storage may reallocate while it is still being filled.
+    using extent = std::pair<std::size_t, std::size_t>;
+    std::vector<extent> knights, kings, rays;
+    ext::array<std::vector<extent>, 2> pawns;
+
+    auto edge = static_cast<int>(length);
+
+    // Returns the square reached by walking some number of steps along a delta, if it exists.
+    auto walk = [&](const std::size_t from, const detail::delta d, const int steps) -> std::optional<std::size_t> {
+        int rank = static_cast<int>(from / length) + (d.rank * steps);
+        int file = static_cast<int>(from % length) + (d.file * steps);
+
+        if(rank < 0 || rank >= edge || file < 0 || file >= edge) {
+            return std::nullopt;
+        }
+
+        return static_cast<std::size_t>((rank * edge) + file);
+    };
+
+    // Appends every square reachable in a single step from a set of deltas.
+    auto leap = [&](const std::size_t from, const auto& deltas) {
+        extent e = {m_storage.size(), 0};
+
+        for(const auto& d : deltas) {
+            if(auto to = walk(from, d, 1)) {
+                m_storage.push_back(*to);
+                ++e.second;
+            }
+        }
+
+        return e;
+    };
+
+    m_coordinates.reserve(squares);
+
+    for(std::size_t i = 0; i < squares; ++i) {
+        m_coordinates.push_back({i / length, i % length});
+        knights.push_back(leap(i, detail::knight_deltas));
+        kings.push_back(leap(i, detail::direction_deltas));
+        pawns[piece::color::white].push_back(leap(i, detail::pawn_deltas[piece::color::white]));
+        pawns[piece::color::black].push_back(leap(i, detail::pawn_deltas[piece::color::black]));
+
+        for(const auto& d : detail::direction_deltas) {
+            extent e = {m_storage.size(), 0};
+
+            for(int steps = 1; auto to = walk(i, d, steps); ++steps) {
+                m_storage.push_back(*to);
+                ++e.second;
+            }
+
+            rays.push_back(e);
+        }
+    }
+
+    // Now that the storage won't move, convert every extent into a view.
+    auto view = [&](const std::vector<extent>& extents, std::vector<std::span<const std::size_t>>& views) {
+        views.reserve(extents.size());
+
+        for(const auto& [offset, size] : extents) {
+            views.emplace_back(m_storage.data() + offset, size);
+        }
+    };
+
+    view(knights, m_knights);
+    view(kings, m_kings);
+    view(pawns[piece::color::white], m_pawns[piece::color::white]);
+    view(pawns[piece::color::black], m_pawns[piece::color::black]);
+    view(rays, m_rays);
+}
+
+std::optional<bcl::direction> bcl::geometry::heading(const std::size_t from, const std::size_t to) const noexcept {
+    const auto& source = m_coordinates[from];
+    const auto& sink = m_coordinates[to];
+
+    // Each component is -1, 0 or +1 depending on which way the destination lies.
+    int rank = (sink.rank > source.rank) - (sink.rank < source.rank);
+    int file = (sink.file > source.file) - (sink.file < source.file);
+
+    // Squares share a line if they lie on the same rank or file, or are as many ranks apart as files.
+    std::size_t ranks = (rank > 0) ? sink.rank - source.rank : source.rank - sink.rank;
+    std::size_t files = (file > 0) ? sink.file - source.file : source.file - sink.file;
+
+    if((ranks == 0 && files == 0) || (ranks != 0 && files != 0 && ranks != files)) {
+        return std::nullopt;
+    }
+
+    for(auto d = direction::first; d <= direction::last; d = d + 1) {
+        const auto& delta = detail::direction_deltas[d];
+        if(delta.rank == rank && delta.file == file) {
+            return d;
+        }
+    }
+
+    return std::nullopt;
+}
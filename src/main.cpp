@@ -7,7 +7,10 @@
 #include <argparse/argparse.hpp>
 #include <centurion.hpp>
 #include <fmt/core.h>
+#include <stdexcept>
 #include <cstddef>
+#include <optional>
+#include <utility>
 #include <future>
 #include <chrono>
 
@@ -18,6 +21,10 @@ namespace defaults {
     constexpr bool anarchy = false;
     constexpr bool bot = true;
     constexpr bool perft = false;
+    constexpr bool divide = false;
+    constexpr std::size_t threads = 1;
+    constexpr std::size_t cache_megabytes = 0;
+    constexpr std::size_t hash_megabytes = 16;
 
     // Sadly, constexpr std::string isn't a thing yet.
     const std::string fen_8x8 = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
@@ -29,7 +36,7 @@ int main(int argc, char** argv) {
 
     program.add_argument("-s", "--size")
         .required()
-        .help("the size of the board")
+        .help(fmt::format("the size of the board (between {} and {})", bcl::constants::minimum_length, bcl::constants::maximum_length))
         .scan<'u', std::size_t>()
         .default_value(defaults::board_size);
 
@@ -56,6 +63,12 @@ int main(int argc, char** argv) {
         .default_value(defaults::anarchy)
         .implicit_value(!defaults::anarchy);
 
+    program.add_argument("-H", "--hash")
+        .required()
+        .help("the size of the bot's transposition table in megabytes")
+        .scan<'u', std::size_t>()
+        .default_value(defaults::hash_megabytes);
+
     program.add_argument("-b", "--bot")
         .required()
         .help("play the built-in bot")
@@ -68,6 +81,24 @@ int main(int argc, char** argv) {
         .default_value(defaults::perft)
         .implicit_value(!defaults::perft);
 
+    program.add_argument("-t", "--threads")
+        .required()
+        .help("the number of threads to run perft on")
+        .scan<'u', std::size_t>()
+        .default_value(defaults::threads);
+
+    program.add_argument("-c", "--perft-cache")
+        .required()
+        .help("the size of the perft cache in megabytes (0 to disable it)")
+        .scan<'u', std::size_t>()
+        .default_value(defaults::cache_megabytes);
+
+    program.add_argument("--perft-divide")
+        .required()
+        .help("run perft at the bot's depth, broken down by move")
+        .default_value(defaults::divide)
+        .implicit_value(!defaults::divide);
+
     // Let this throw if there are any runtime errors.
     program.parse_args(argc, argv);
 
@@ -77,10 +108,28 @@ int main(int argc, char** argv) {
     auto fen_string = program.get<std::string>("fen");
     auto anarchy = program.get<bool>("anarchy");
     auto bot = program.get<bool>("bot");
+    auto hash_megabytes = program.get<std::size_t>("hash");
     auto perft = program.get<bool>("perft");
+    auto divide = program.get<bool>("perft-divide");
+    auto threads = program.get<std::size_t>("threads");
+    auto cache_megabytes = program.get<std::size_t>("perft-cache");
+
+    if(board_size < bcl::constants::minimum_length || board_size > bcl::constants::maximum_length) {
+        throw std::runtime_error(fmt::format("--size must be between {} and {}", bcl::constants::minimum_length, bcl::constants::maximum_length));
+    }
+
+    // The breakdown is by the first move made, so at least one ply has to be searched.
+    if(divide && search_depth == 0) {
+        throw std::runtime_error("--perft-divide requires a depth of at least 1");
+    }
+
+    if(board_size == bcl::bitboards::length) {
+        auto method = (bcl::bitboards::accelerated()) ? "PEXT" : "magic multiplication";
+        fmt::print("[bongcloud] sliding piece attacks indexed using {}.\n", method);
+    }
 
     bcl::board board(board_size, anarchy);
-    bcl::ai engine(search_depth, bot);
+    bcl::ai engine(search_depth, bot, hash_megabytes);
     board.load(fen_string);
 
     // This must be done at the start to
@@ -89,35 +138,74 @@ int main(int argc, char** argv) {
 
     if(perft) {
         // Run performance/correctness testing and then exit the program.
+        // The cache is kept between depths, since each run revisits the positions of the last.
+        std::optional<bcl::cache> cache;
+        if(cache_megabytes > 0) {
+            cache.emplace(cache_megabytes * 1024 * 1024);
+        }
+
         for(std::size_t i = 1; i < engine.layers + 1; ++i) {
-            auto n = board.positions(i);
+            auto n = board.positions(i, threads, (cache) ? &*cache : nullptr);
             fmt::print("[bongcloud] no. of positions after {} ply: {}\n", i, n);
         }
 
         return 0;
     }
 
+    if(divide) {
+        // Print the positions after each move in coordinate notation (eg. e2e4, or e7e8q when promoting),
+        // which can be compared against another engine's to find the moves being generated wrongly.
+        auto name = [&](const std::size_t square) {
+            auto file = static_cast<char>('a' + (square % board_size));
+            return fmt::format("{}{}", file, (square / board_size) + 1);
+        };
+
+        bcl::tally total {};
+
+        for(const auto& [move, tally] : board.divide(engine.layers)) {
+            auto suffix = (move.kind() == bcl::piece::move::promotion) ? fmt::format("{}", bcl::constants::piece_letters[move.promotion()]) : "";
+            fmt::print("[bongcloud] {}{}{}: {}\n", name(move.from()), name(move.to()), suffix, tally.positions);
+            total += tally;
+        }
+
+        fmt::print("[bongcloud] no. of positions after {} ply: {}\n", engine.layers, total.positions);
+        fmt::print(
+            "[bongcloud] captures: {}, en passant: {}, castles: {}, promotions: {}, checks: {}\n",
+            total.captures, total.passants, total.castles, total.promotions, total.checks
+        );
+
+        return 0;
+    }
+
     bcl::renderer renderer(square_res, board_size);
     bcl::event_dispatcher dispatcher(board, engine, renderer);
 
     while(dispatcher.running()) {
         dispatcher.poll();
 
-        if(engine.enabled && board.color() == engine_color) {
+        // The board caches the game's status, so this only does any work after a move has been made.
+        // It's worked out before the engine is started so that the engine's snapshot carries it along.
+        auto status = board.status();
+
+        if(engine.enabled && board.color() == engine_color && status == bcl::status::ongoing) {
             if(engine.future.valid()) {
                 // If the future is valid, then the AI could either
                 // have a result for us or still be thinking.
                 using namespace std::chrono_literals;
                 if(engine.future.wait_for(0ms) == std::future_status::ready) {
                     if(auto move = engine.future.get()) {
-                        board.move(move->from, move->to);
+                        board.make(*move);
                     }
                 }
             }
 
             else {
-                // Otherwise, spawn a new thread to evaluate this position.
-                auto subroutine = [&]() { return engine.generate(board); };
+                // Otherwise, spawn a new thread to evaluate this position. The thread searches its own
+                // snapshot of the board (taken here), so the renderer can keep reading the real one.
+                auto subroutine = [&engine, local = board.snapshot(engine.layers + 1)]() mutable {
+                    return engine.generate(std::move(local));
+                };
+
                 engine.future = std::async(std::launch::async, subroutine);
             }
         }
@@ -125,7 +213,7 @@ int main(int argc, char** argv) {
         renderer.render(board);
 
         if(!dispatcher.popup) {
-            if(board.checkmate()) {
+            if(status == bcl::status::checkmate) {
                 dispatcher.popup = true;
                 std::string title = "Checkmate!";
                 std::string message = fmt::format(
@@ -136,12 +224,19 @@ int main(int argc, char** argv) {
                 cen::message_box::show(title, message);
             }
 
-            else if(board.stalemate()) {
+            else if(status == bcl::status::stalemate) {
                 dispatcher.popup = true;
                 std::string title = "Stalemate!";
                 std::string message = "Game: draw by stalemate.";
                 cen::message_box::show(title, message);
             }
+
+            else if(status == bcl::status::draw) {
+                dispatcher.popup = true;
+                std::string title = "Draw!";
+                std::string message = "Game: draw by the 50 move rule.";
+                cen::message_box::show(title, message);
+            }
         }
     }
 
@@ -0,0 +1,674 @@
+#include "geometry.hpp"
+#include "bitboard.hpp"
+#include "pieces.hpp"
+#include "extras.hpp"
+#include "rules.hpp"
+#include "board.hpp"
+
+#include <optional>
+#include <cassert>
+#include <vector>
+#include <span>
+
+namespace detail {
+    // The first and last ranks of an 8x8 board, where pawns are promoted.
+    constexpr bcl::bitboard edges = 0xFF000000000000FFULL;
+
+    // Returns the pieces in a set of enemies that attack a square on an 8x8 board, given
+    // the set of occupied squares. The color is that of the side defending the square.
+    bcl::bitboard attackers(const bcl::occupancy& sets, const std::size_t i, const bcl::piece::color color, const bcl::bitboard occupied, const bcl::bitboard enemies) noexcept {
+        using type = bcl::piece::type;
+        const auto& types = sets.types;
+
+        return enemies & (
+            (bcl::bitboards::pawn[color][i] & types[type::pawn]) |
+            (bcl::bitboards::knight[i] & types[type::knight]) |
+            (bcl::bitboards::king[i] & types[type::king]) |
+            (bcl::bitboards::bishop(i, occupied) & (types[type::bishop] | types[type::queen])) |
+            (bcl::bitboards::rook(i, occupied) & (types[type::rook] | types[type::queen]))
+        );
+    }
+
+    // Returns the squares that a piece other than the king can move to without leaving the king in check,
+    // ignoring pins. This is every square out of check, or the checker and its line in single check.
+    bcl::bitboard evasions(const bcl::threats<bcl::bitboard>& threats, const std::size_t king) noexcept {
+        if(!threats.checkers) {
+            return ~bcl::bitboard {0};
+        }
+
+        return threats.checkers | bcl::bitboards::between(king, bcl::bitboards::first(threats.checkers));
+    }
+
+    bcl::squareset evasions(const bcl::geometry& grid, const bcl::threats<bcl::squareset>& threats, const std::size_t king) noexcept {
+        bcl::squareset evasions;
+
+        if(threats.checkers.none()) {
+            return evasions.set();
+        }
+
+        std::size_t checker = 0;
+        while(!threats.checkers.test(checker)) {
+            ++checker;
+        }
+
+        evasions.set(checker);
+
+        // Knights can't be blocked, so they have no heading (and adjacent pieces have nothing in between).
+        if(auto heading = grid.heading(king, checker)) {
+            for(std::size_t i : grid.ray(king, *heading)) {
+                if(i == checker) {
+                    break;
+                }
+
+                evasions.set(i);
+            }
+        }
+
+        return evasions;
+    }
+}
+
+std::vector<bcl::move> bcl::board::moves(void) const noexcept {
+    std::vector<bcl::move> moves;
+
+    bcl::dispatch(*this, [&](auto policy) {
+        decltype(policy)::each(*this, [&](const bcl::move m) {
+            moves.push_back(m);
+        });
+    });
+
+    return moves;
+}
+
+void bcl::board::moves(movelist& moves, const generation kind) const noexcept {
+    assert(!m_anarchy);
+
+    // No moves can be made once the game has been drawn by the 50 move rule.
+    if(m_trivials >= constants::trivial_force_draw) {
+        return;
+    }
+
+    if(m_occupancy) {
+        this->bitboard_moves(moves, kind);
+    } else {
+        this->mailbox_moves(moves, kind);
+    }
+}
+
+void bcl::board::bitboard_moves(movelist& moves, const generation kind) const noexcept {
+    const auto& sets = *m_occupancy;
+    const auto& types = sets.types;
+    const auto& threats = m_bitboard_threats.back();
+
+    auto us = m_color;
+    auto them = ext::flip(us);
+    bool white = (us == piece::color::white);
+    std::size_t king = m_kings[us];
+
+    bitboard friendly = sets.colors[us];
+    bitboard enemies = sets.colors[them];
+    bitboard occupied = sets.all();
+
+    // Captures land on enemies and quiet moves on empty squares, except
+    // for pawns reaching either end of the board, which are promotions.
+    bool captures = (kind == generation::all || kind == generation::captures);
+    bool promotions = (kind == generation::all || kind == generation::promotions);
+    bool quiets = (kind == generation::all || kind == generation::quiets);
+
+    bitboard edges = detail::edges;
+    bitboard scope = ((captures) ? enemies : 0) | ((quiets) ? ~occupied : 0);
+    bitboard advances = (scope & ~edges) | ((promotions) ? edges : 0);
+
+    auto emit = [&](const std::size_t from, bitboard targets) {
+        while(targets) {
+            std::size_t to = bitboards::pop(targets);
+            bool capture = (enemies & bitboards::square(to)) != 0;
+            moves.push_back({from, to, (capture) ? piece::move::capture : piece::move::normal});
+        }
+    };
+
+    // Pawns reaching either end of the board are promoted to every promotion piece in turn.
+    auto advance = [&](const std::size_t from, bitboard targets) {
+        for(bitboard b = targets & edges; b;) {
+            std::size_t to = bitboards::pop(b);
+            for(auto type : constants::promotion_pieces) {
+                moves.push_back({from, to, piece::move::promotion, type});
+            }
+        }
+
+        emit(from, targets & ~edges);
+    };
+
+    // The king can step onto any square that isn't attacked. Since attackers are looked for
+    // with the king seen through, it can't retreat along a checking line either.
+    bitboard steps = 0;
+    for(bitboard b = bitboards::king[king] & ~friendly & scope; b;) {
+        std::size_t to = bitboards::pop(b);
+        if(!this->attacked(to, them, king)) {
+            steps |= bitboards::square(to);
+        }
+    }
+
+    emit(king, steps);
+
+    // In double check, only the king can move.
+    std::size_t checks = bitboards::count(threats.checkers);
+    if(checks > 1) {
+        return;
+    }
+
+    // In single check, every other piece must capture the checker or block its line.
+    bitboard evasions = detail::evasions(threats, king);
+
+    // Pinned pieces are confined to the line running through them and their king.
+    auto restrict = [&](const std::size_t from, bitboard targets) {
+        if(threats.pinned[us] & bitboards::square(from)) {
+            targets &= bitboards::line(king, from);
+        }
+
+        return targets & evasions & ~friendly & scope;
+    };
+
+    for(bitboard b = friendly & types[piece::type::knight]; b;) {
+        std::size_t from = bitboards::pop(b);
+        emit(from, restrict(from, bitboards::knight[from]));
+    }
+
+    for(bitboard b = friendly & types[piece::type::bishop]; b;) {
+        std::size_t from = bitboards::pop(b);
+        emit(from, restrict(from, bitboards::bishop(from, occupied)));
+    }
+
+    for(bitboard b = friendly & types[piece::type::rook]; b;) {
+        std::size_t from = bitboards::pop(b);
+        emit(from, restrict(from, bitboards::rook(from, occupied)));
+    }
+
+    for(bitboard b = friendly & types[piece::type::queen]; b;) {
+        std::size_t from = bitboards::pop(b);
+        emit(from, restrict(from, bitboards::queen(from, occupied)));
+    }
+
+    for(bitboard b = friendly & types[piece::type::pawn]; b;) {
+        // Pawns may push twice from their starting rank if both squares ahead are empty.
+        std::size_t from = bitboards::pop(b);
+        std::size_t rank = from / bitboards::length;
+        bitboard origin = bitboards::square(from);
+        bitboard push = ((white) ? origin << bitboards::length : origin >> bitboards::length) & ~occupied;
+        bitboard jump = 0;
+
+        if(rank == 1 || rank == bitboards::length - 2) {
+            jump = ((white) ? push << bitboards::length : push >> bitboards::length) & ~occupied;
+        }
+
+        bitboard takes = bitboards::pawn[us][from] & enemies;
+        bitboard targets = push | jump | takes;
+
+        if(threats.pinned[us] & origin) {
+            targets &= bitboards::line(king, from);
+        }
+
+        advance(from, targets & evasions & advances);
+    }
+
+    // En passant is checked by playing the capture out on a copy of the occupancy,
+    // since removing two pawns from the same rank can expose the king in unusual ways.
+    const auto& latest = this->latest();
+
+    if(latest && captures) {
+        std::size_t victim = latest->to();
+        const auto& prey = m_internal[victim];
+        std::size_t distance = (latest->from() > victim) ? latest->from() - victim : victim - latest->from();
+        std::size_t rank = victim / bitboards::length;
+        bool reachable = (white) ? rank + 1 < bitboards::length : rank > 0;
+
+        if(prey && prey->variety == piece::type::pawn && distance == bitboards::length * 2 && reachable) {
+            std::size_t target = (white) ? victim + bitboards::length : victim - bitboards::length;
+            // Masking with the king's steps stops the shifts from wrapping around the edge of the board.
+            bitboard flanks = bitboards::king[victim] & ((bitboards::square(victim) << 1) | (bitboards::square(victim) >> 1));
+
+            for(bitboard b = flanks & friendly & types[piece::type::pawn]; b && !m_internal[target];) {
+                std::size_t from = bitboards::pop(b);
+                bitboard after = (occupied & ~bitboards::square(from) & ~bitboards::square(victim)) | bitboards::square(target);
+
+                if(!detail::attackers(sets, king, us, after, enemies & ~bitboards::square(victim))) {
+                    moves.push_back({from, target, piece::move::en_passant});
+                }
+            }
+        }
+    }
+
+    // Castling is only possible out of check, and the king can't cross or land on an attacked square.
+    if(checks == 0 && quiets) {
+        std::size_t file = king % bitboards::length;
+
+        // The king must be far enough from the edge before its destination is worked out,
+        // since a king on the a- or b-file would otherwise wrap around to a huge square index.
+        auto attempt = [&](const std::size_t to, const std::size_t crossed) {
+            if(m_internal[to]) {
+                return;
+            }
+
+            auto type = this->castleable(king, to);
+
+            if(type && !this->attacked(crossed, them) && !this->attacked(to, them)) {
+                moves.push_back({king, to, *type});
+            }
+        };
+
+        if(file + 2 < bitboards::length) {
+            attempt(king + 2, king + 1);
+        }
+
+        if(file >= 2) {
+            attempt(king - 2, king - 1);
+        }
+    }
+}
+
+void bcl::board::mailbox_moves(movelist& moves, const generation kind) const noexcept {
+    const auto& grid = *m_geometry;
+    const auto& roster = *m_roster;
+    const auto& threats = m_mailbox_threats.back();
+
+    auto us = m_color;
+    auto them = ext::flip(us);
+    bool white = (us == piece::color::white);
+    std::size_t king = m_kings[us];
+
+    auto friendly = [&](const std::size_t i) {
+        return m_internal[i] && m_internal[i]->hue == us;
+    };
+
+    auto hostile = [&](const std::size_t i) {
+        return m_internal[i] && m_internal[i]->hue == them;
+    };
+
+    // Captures land on enemies and quiet moves on empty squares, except
+    // for pawns reaching either end of the board, which are promotions.
+    bool captures = (kind == generation::all || kind == generation::captures);
+    bool promotions = (kind == generation::all || kind == generation::promotions);
+    bool quiets = (kind == generation::all || kind == generation::quiets);
+
+    auto promoting = [&](const std::size_t from, const std::size_t to) {
+        bool pawn = m_internal[from]->variety == piece::type::pawn;
+        return pawn && (grid[to].rank == 0 || grid[to].rank == grid.length - 1);
+    };
+
+    auto wanted = [&](const std::size_t from, const std::size_t to) {
+        if(promoting(from, to)) {
+            return promotions;
+        }
+
+        return (m_internal[to]) ? captures : quiets;
+    };
+
+    // Pawns reaching either end of the board are promoted to every promotion piece in turn.
+    auto emit = [&](const std::size_t from, const std::size_t to) {
+        if(promoting(from, to)) {
+            for(auto type : constants::promotion_pieces) {
+                moves.push_back({from, to, piece::move::promotion, type});
+            }
+
+            return;
+        }
+
+        moves.push_back({from, to, (m_internal[to]) ? piece::move::capture : piece::move::normal});
+    };
+
+    // The king can step onto any square that isn't attacked. Since attackers are looked for
+    // with the king seen through, it can't retreat along a checking line either.
+    for(std::size_t to : grid.king(king)) {
+        if(!friendly(to) && wanted(king, to) && !this->attacked(to, them, king)) {
+            emit(king, to);
+        }
+    }
+
+    // In double check, only the king can move.
+    std::size_t checks = threats.checkers.count();
+    if(checks > 1) {
+        return;
+    }
+
+    // In single check, every other piece must capture the checker or block its line.
+    squareset evasions = detail::evasions(grid, threats, king);
+
+    // Pinned pieces are confined to the line running through them and their king.
+    auto attempt = [&](const std::size_t from, const std::size_t to) {
+        bool confined = threats.pinned[us].test(from) && grid.heading(king, to) != grid.heading(king, from);
+
+        if(evasions.test(to) && !confined && wanted(from, to)) {
+            emit(from, to);
+        }
+    };
+
+    for(auto type = piece::type::first; type <= piece::type::last; type = type + 1) {
+        for(std::size_t from : roster(us, type)) {
+            switch(type) {
+                case piece::type::pawn: {
+                    // Pawns may push twice from their starting rank if both squares ahead are empty.
+                    auto path = grid.ray(from, (white) ? direction::north : direction::south);
+                    std::size_t rank = grid[from].rank;
+
+                    if(!path.empty() && !m_internal[path[0]]) {
+                        attempt(from, path[0]);
+
+                        bool starting = (rank == 1 || rank == grid.length - 2);
+                        if(starting && path.size() > 1 && !m_internal[path[1]]) {
+                            attempt(from, path[1]);
+                        }
+                    }
+
+                    for(std::size_t to : grid.pawn(us, from)) {
+                        if(hostile(to)) {
+                            attempt(from, to);
+                        }
+                    }
+
+                    break;
+                }
+
+                case piece::type::knight: {
+                    for(std::size_t to : grid.knight(from)) {
+                        if(!friendly(to)) {
+                            attempt(from, to);
+                        }
+                    }
+
+                    break;
+                }
+
+                case piece::type::bishop:
+                case piece::type::rook:
+                case piece::type::queen: {
+                    for(auto d = direction::first; d <= direction::last; d = d + 1) {
+                        if(!slides(type, d)) {
+                            continue;
+                        }
+
+                        // Walk along the ray until a piece is reached, which can be captured if it's an enemy.
+                        for(std::size_t to : grid.ray(from, d)) {
+                            if(!friendly(to)) {
+                                attempt(from, to);
+                            }
+
+                            if(m_internal[to]) {
+                                break;
+                            }
+                        }
+                    }
+
+                    break;
+                }
+
+                case piece::type::king: {
+                    // The king has already been dealt with.
+                    break;
+                }
+            }
+        }
+    }
+
+    // En passant is checked by looking outwards from the king as if the capture had been played,
+    // since removing two pawns from the same rank can expose the king in unusual ways.
+    const auto& latest = this->latest();
+
+    if(latest && captures) {
+        std::size_t victim = latest->to();
+        const auto& prey = m_internal[victim];
+        std::size_t distance = (latest->from() > victim) ? latest->from() - victim : victim - latest->from();
+        auto behind = grid.ray(victim, (white) ? direction::north : direction::south);
+
+        if(prey && prey->variety == piece::type::pawn && distance == grid.length * 2 && !behind.empty() && !m_internal[behind[0]]) {
+            std::size_t target = behind[0];
+
+            for(auto side : {direction::east, direction::west}) {
+                auto flank = grid.ray(victim, side);
+                if(flank.empty()) {
+                    continue;
+                }
+
+                std::size_t from = flank[0];
+                const auto& hunter = m_internal[from];
+                if(!hunter || hunter->hue != us || hunter->variety != piece::type::pawn) {
+                    continue;
+                }
+
+                auto occupied = [&](const std::size_t i) {
+                    return i == target || (m_internal[i] && i != from && i != victim);
+                };
+
+                auto leaper = [&](const std::span<const std::size_t> squares, const piece::type type) {
+                    for(std::size_t i : squares) {
+                        if(i != victim && hostile(i) && m_internal[i]->variety == type) {
+                            return true;
+                        }
+                    }
+
+                    return false;
+                };
+
+                bool exposed = {
+                    leaper(grid.pawn(us, king), piece::type::pawn) ||
+                    leaper(grid.knight(king), piece::type::knight) ||
+                    leaper(grid.king(king), piece::type::king)
+                };
+
+                for(auto d = direction::first; d <= direction::last && !exposed; d = d + 1) {
+                    for(std::size_t i : grid.ray(king, d)) {
+                        if(occupied(i)) {
+                            exposed = i != target && hostile(i) && slides(m_internal[i]->variety, d);
+                            break;
+                        }
+                    }
+                }
+
+                if(!exposed) {
+                    moves.push_back({from, target, piece::move::en_passant});
+                }
+            }
+        }
+    }
+
+    // Castling is only possible out of check, and the king can't cross or land on an attacked square.
+    if(checks == 0 && quiets) {
+        for(auto side : {direction::east, direction::west}) {
+            auto path = grid.ray(king, side);
+            if(path.size() < 2 || m_internal[path[1]]) {
+                continue;
+            }
+
+            auto type = this->castleable(king, path[1]);
+
+            if(type && !this->attacked(path[0], them) && !this->attacked(path[1], them)) {
+                moves.push_back({king, path[1], *type});
+            }
+        }
+    }
+}
+
+bool bcl::board::bitboard_mobile(void) const noexcept {
+    const auto& sets = *m_occupancy;
+    const auto& types = sets.types;
+    const auto& threats = m_bitboard_threats.back();
+
+    auto us = m_color;
+    auto them = ext::flip(us);
+    bool white = (us == piece::color::white);
+    std::size_t king = m_kings[us];
+
+    bitboard friendly = sets.colors[us];
+    bitboard occupied = sets.all();
+
+    // The king usually has somewhere to step to, and doesn't have to worry about pins.
+    for(bitboard b = bitboards::king[king] & ~friendly; b;) {
+        if(!this->attacked(bitboards::pop(b), them, king)) {
+            return true;
+        }
+    }
+
+    // In double check, only the king can move.
+    if(bitboards::count(threats.checkers) > 1) {
+        return false;
+    }
+
+    bitboard evasions = detail::evasions(threats, king);
+
+    auto reaches = [&](const std::size_t from, bitboard targets) {
+        if(threats.pinned[us] & bitboards::square(from)) {
+            targets &= bitboards::line(king, from);
+        }
+
+        return (targets & evasions & ~friendly) != 0;
+    };
+
+    for(bitboard b = friendly & types[piece::type::knight]; b;) {
+        std::size_t from = bitboards::pop(b);
+        if(reaches(from, bitboards::knight[from])) {
+            return true;
+        }
+    }
+
+    for(bitboard b = friendly & (types[piece::type::bishop] | types[piece::type::rook] | types[piece::type::queen]); b;) {
+        std::size_t from = bitboards::pop(b);
+        bitboard targets = 0;
+
+        if(types[piece::type::rook] & bitboards::square(from)) {
+            targets = bitboards::rook(from, occupied);
+        } else if(types[piece::type::bishop] & bitboards::square(from)) {
+            targets = bitboards::bishop(from, occupied);
+        } else {
+            targets = bitboards::queen(from, occupied);
+        }
+
+        if(reaches(from, targets)) {
+            return true;
+        }
+    }
+
+    for(bitboard b = friendly & types[piece::type::pawn]; b;) {
+        // Pawns may push twice from their starting rank if both squares ahead are empty.
+        std::size_t from = bitboards::pop(b);
+        std::size_t rank = from / bitboards::length;
+        bitboard origin = bitboards::square(from);
+        bitboard push = ((white) ? origin << bitboards::length : origin >> bitboards::length) & ~occupied;
+        bitboard jump = 0;
+
+        if(rank == 1 || rank == bitboards::length - 2) {
+            jump = ((white) ? push << bitboards::length : push >> bitboards::length) & ~occupied;
+        }
+
+        if(reaches(from, push | jump | (bitboards::pawn[us][from] & sets.colors[them]))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool bcl::board::mailbox_mobile(void) const noexcept {
+    const auto& grid = *m_geometry;
+    const auto& roster = *m_roster;
+    const auto& threats = m_mailbox_threats.back();
+
+    auto us = m_color;
+    auto them = ext::flip(us);
+    bool white = (us == piece::color::white);
+    std::size_t king = m_kings[us];
+
+    auto friendly = [&](const std::size_t i) {
+        return m_internal[i] && m_internal[i]->hue == us;
+    };
+
+    auto hostile = [&](const std::size_t i) {
+        return m_internal[i] && m_internal[i]->hue == them;
+    };
+
+    // The king usually has somewhere to step to, and doesn't have to worry about pins.
+    for(std::size_t to : grid.king(king)) {
+        if(!friendly(to) && !this->attacked(to, them, king)) {
+            return true;
+        }
+    }
+
+    // In double check, only the king can move.
+    if(threats.checkers.count() > 1) {
+        return false;
+    }
+
+    squareset evasions = detail::evasions(grid, threats, king);
+
+    auto reaches = [&](const std::size_t from, const std::size_t to) {
+        bool confined = threats.pinned[us].test(from) && grid.heading(king, to) != grid.heading(king, from);
+        return evasions.test(to) && !confined;
+    };
+
+    for(auto type = piece::type::first; type < piece::type::king; type = type + 1) {
+        for(std::size_t from : roster(us, type)) {
+            switch(type) {
+                case piece::type::pawn: {
+                    auto path = grid.ray(from, (white) ? direction::north : direction::south);
+                    std::size_t rank = grid[from].rank;
+
+                    if(!path.empty() && !m_internal[path[0]]) {
+                        if(reaches(from, path[0])) {
+                            return true;
+                        }
+
+                        bool starting = (rank == 1 || rank == grid.length - 2);
+                        if(starting && path.size() > 1 && !m_internal[path[1]] && reaches(from, path[1])) {
+                            return true;
+                        }
+                    }
+
+                    for(std::size_t to : grid.pawn(us, from)) {
+                        if(hostile(to) && reaches(from, to)) {
+                            return true;
+                        }
+                    }
+
+                    break;
+                }
+
+                case piece::type::knight: {
+                    for(std::size_t to : grid.knight(from)) {
+                        if(!friendly(to) && reaches(from, to)) {
+                            return true;
+                        }
+                    }
+
+                    break;
+                }
+
+                case piece::type::bishop:
+                case piece::type::rook:
+                case piece::type::queen: {
+                    for(auto d = direction::first; d <= direction::last; d = d + 1) {
+                        if(!slides(type, d)) {
+                            continue;
+                        }
+
+                        for(std::size_t to : grid.ray(from, d)) {
+                            if(!friendly(to) && reaches(from, to)) {
+                                return true;
+                            }
+
+                            if(m_internal[to]) {
+                                break;
+                            }
+                        }
+                    }
+
+                    break;
+                }
+
+                case piece::type::king: {
+                    // The king has already been dealt with.
+                    break;
+                }
+            }
+        }
+    }
+
+    return false;
+}
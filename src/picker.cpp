@@ -0,0 +1,270 @@
+#include "picker.hpp"
+#include "pieces.hpp"
+#include "extras.hpp"
+#include "board.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+std::optional<bcl::generation> bcl::picker::classify(const board& board, const bcl::move move) noexcept {
+    std::size_t squares = board.length * board.length;
+    if(move.from() >= squares || move.to() >= squares || move.from() == move.to()) {
+        return std::nullopt;
+    }
+
+    // Any piece can move in anarchy mode, and nothing is ever promoted or captured en passant.
+    const auto& origin = board[move.from()];
+    if(origin && board.anarchy()) {
+        return (board[move.to()]) ? generation::captures : generation::quiets;
+    }
+
+    if(!origin || origin->hue != board.color()) {
+        return std::nullopt;
+    }
+
+    // Pawns moving diagonally onto an empty square are capturing en passant.
+    bool pawn = origin->variety == piece::type::pawn;
+    std::size_t rank = move.to() / board.length;
+    bool diagonal = move.from() % board.length != move.to() % board.length;
+
+    if(pawn && (rank == 0 || rank == board.length - 1)) {
+        return generation::promotions;
+    }
+
+    if(board[move.to()] || (pawn && diagonal)) {
+        return generation::captures;
+    }
+
+    return generation::quiets;
+}
+
+void bcl::picker::advance(void) noexcept {
+    // Each stage either yields its next move or falls through to the next stage.
+    for(;;) {
+        switch(m_stage) {
+            case stage::hash: {
+                m_stage = stage::captures;
+
+                if(m_hash && this->legal(*m_hash)) {
+                    m_current = *m_hash;
+                    return;
+                }
+
+                m_hash = std::nullopt;
+                break;
+            }
+
+            case stage::captures: {
+                if(m_board.anarchy()) {
+                    m_stage = stage::killer;
+                    m_index = 0;
+                    break;
+                }
+
+                auto captures = this->list(generation::captures);
+                m_index = captures.first;
+                m_losing = captures.last;
+                m_stage = stage::winning;
+                break;
+            }
+
+            case stage::winning: {
+                // Captures are sorted lazily by repeatedly selecting the best of the remainder, so captures
+                // after a cutoff are never sorted. Losing captures are set aside until after the quiet moves.
+                if(m_index < m_losing) {
+                    std::size_t best = m_index;
+                    for(std::size_t i = m_index + 1; i < m_losing; ++i) {
+                        if(this->score(m_moves[i]) > this->score(m_moves[best])) {
+                            best = i;
+                        }
+                    }
+
+                    if(this->losing(m_moves[best])) {
+                        std::swap(m_moves[best], m_moves[--m_losing]);
+                        break;
+                    }
+
+                    std::swap(m_moves[best], m_moves[m_index]);
+                    auto m = m_moves[m_index++];
+
+                    if(!this->picked(m)) {
+                        m_current = m;
+                        return;
+                    }
+
+                    break;
+                }
+
+                m_stage = stage::promotions;
+                m_index = this->list(generation::promotions).first;
+                break;
+            }
+
+            case stage::promotions: {
+                if(m_index < m_segments[generation::promotions].last) {
+                    auto m = m_moves[m_index++];
+                    if(!this->picked(m)) {
+                        m_current = m;
+                        return;
+                    }
+
+                    break;
+                }
+
+                m_stage = stage::killer;
+                m_index = 0;
+                break;
+            }
+
+            case stage::killer: {
+                if(m_index < m_killers.size()) {
+                    // Killers come from other positions, so they have to be checked before being played.
+                    // Any that turn out to be illegal (or not quiet here) are forgotten.
+                    auto& killer = m_killers[m_index];
+                    auto earlier = m_killers.begin() + static_cast<std::ptrdiff_t>(m_index++);
+                    bool playable = {
+                        killer && !(m_hash && *killer == *m_hash) &&
+                        std::find(m_killers.begin(), earlier, killer) == earlier &&
+                        picker::classify(m_board, *killer) == generation::quiets &&
+                        this->legal(*killer)
+                    };
+
+                    if(playable) {
+                        m_current = *killer;
+                        return;
+                    }
+
+                    killer = std::nullopt;
+                    break;
+                }
+
+                m_stage = stage::quiets;
+                m_index = (m_board.anarchy()) ? 0 : this->list(generation::quiets).first;
+                break;
+            }
+
+            case stage::quiets: {
+                if(m_board.anarchy()) {
+                    this->wander();
+                    return;
+                }
+
+                if(m_index < m_segments[generation::quiets].last) {
+                    auto m = m_moves[m_index++];
+                    if(!this->picked(m)) {
+                        m_current = m;
+                        return;
+                    }
+
+                    break;
+                }
+
+                // Losing captures were moved to the end of the captures best first, so they're walked backwards.
+                m_stage = stage::losing;
+                m_index = m_segments[generation::captures].last;
+                break;
+            }
+
+            case stage::losing: {
+                if(m_index > m_losing) {
+                    auto m = m_moves[--m_index];
+                    if(!this->picked(m)) {
+                        m_current = m;
+                        return;
+                    }
+
+                    break;
+                }
+
+                m_stage = stage::done;
+                break;
+            }
+
+            case stage::done: {
+                return;
+            }
+        }
+    }
+}
+
+void bcl::picker::wander(void) noexcept {
+    std::size_t squares = m_board.length * m_board.length;
+
+    // The index walks through every (from, to) pair of squares in turn.
+    for(; m_index < squares * squares; ++m_index) {
+        std::size_t from = m_index / squares;
+        std::size_t to = m_index % squares;
+
+        if(from == to || !m_board[from]) {
+            continue;
+        }
+
+        bcl::move m = {from, to, (m_board[to]) ? piece::move::capture : piece::move::normal};
+
+        if(!this->picked(m)) {
+            ++m_index;
+            m_current = m;
+            return;
+        }
+    }
+
+    m_stage = stage::done;
+}
+
+bool bcl::picker::legal(const bcl::move move) noexcept {
+    auto kind = picker::classify(m_board, move);
+
+    // Every move of a piece to another square is legal in anarchy mode.
+    if(!kind || m_board.anarchy()) {
+        return kind.has_value();
+    }
+
+    auto [first, last] = this->list(*kind);
+    return std::find(m_moves.begin() + first, m_moves.begin() + last, move) != m_moves.begin() + last;
+}
+
+bcl::picker::segment bcl::picker::list(const generation kind) noexcept {
+    auto& range = m_segments[kind];
+    auto& generated = m_generated[kind];
+
+    if(!generated) {
+        range.first = m_moves.size();
+        m_board.moves(m_moves, kind);
+        range.last = m_moves.size();
+        generated = true;
+    }
+
+    return range;
+}
+
+bool bcl::picker::picked(const bcl::move move) const noexcept {
+    if(m_hash && move == *m_hash) {
+        return true;
+    }
+
+    // Killers are only played once their stage has been reached.
+    if(m_stage > stage::killer) {
+        return std::any_of(m_killers.begin(), m_killers.end(), [&](const auto& killer) {
+            return killer && move == *killer;
+        });
+    }
+
+    return false;
+}
+
+double bcl::picker::score(const bcl::move move) const noexcept {
+    // Prefer taking the most valuable victim with the least valuable attacker.
+    // Pawns captured en passant aren't on the destination square.
+    const auto& victim = m_board[move.to()];
+    auto taken = constants::piece_values[(victim) ? victim->variety : piece::type::pawn];
+    auto attacker = constants::piece_values[m_board[move.from()]->variety];
+    return (taken * 16.0) - attacker;
+}
+
+bool bcl::picker::losing(const bcl::move move) const noexcept {
+    const auto& victim = m_board[move.to()];
+    auto taken = constants::piece_values[(victim) ? victim->variety : piece::type::pawn];
+    auto attacker = constants::piece_values[m_board[move.from()]->variety];
+    return taken < attacker && m_board.attacked(move.to(), ext::flip(m_board.color()));
+}
@@ -1,263 +1,65 @@
+#include "geometry.hpp"
 #include "pieces.hpp"
 #include "extras.hpp"
 #include "board.hpp"
 
-#include <fmt/core.h>
 #include <cassert>
 
-namespace detail {
-    std::size_t absdiff(const std::size_t a, const std::size_t b) noexcept {
-        return (a > b) ? a - b : b - a;
+bool bcl::board::obstructed(const std::size_t from, const std::size_t to) const noexcept {
+    if(m_occupancy) {
+        // On 8x8 boards, every square in between can be tested at once.
+        return (bitboards::between(from, to) & m_occupancy->all()) != 0;
     }
 
-    bool bishop(const bcl::board& board, const std::size_t from, const std::size_t to) noexcept {
-        assert(from != to);
+    // Otherwise, walk along the precomputed ray leading towards the destination.
+    auto heading = m_geometry->heading(from, to);
+    assert(heading.has_value());
 
-        bcl::index source = {from / board.length, from % board.length};
-        bcl::index sink = {to / board.length, to % board.length};
-
-        // Make sure that the bishop is moving diagonally.
-        assert(
-            detail::absdiff(source.rank, sink.rank) ==
-            detail::absdiff(source.file, sink.file)
-        );
-
-        // The destination square is to the top-right of the origin square.
-        if(source.rank < sink.rank && source.file < sink.file) {
-            for(std::size_t index = from + board.length + 1; index != to; index += board.length + 1) {
-                if(board[index]) {
-                    return true;
-                }
-            }
-        }
-
-        // The destination square is to the bottom-right of the origin square.
-        else if(source.rank > sink.rank && source.file < sink.file) {
-            for(std::size_t index = from - board.length + 1; index != to; index -= board.length - 1) {
-                if(board[index]) {
-                    return true;
-                }
-            }
-        }
-
-        // The destination square is to the bottom-left of the origin square.
-        else if(source.rank > sink.rank && source.file > sink.file) {
-            for(std::size_t index = from - board.length - 1; index != to; index -= board.length + 1) {
-                if(board[index]) {
-                    return true;
-                }
-            }
+    for(std::size_t i : m_geometry->ray(from, *heading)) {
+        if(i == to) {
+            break;
         }
 
-        // The destination square is to the top-left of the origin square.
-        else {
-            for(std::size_t index = from + board.length - 1; index != to; index += board.length - 1) {
-                if(board[index]) {
-                    return true;
-                }
-            }
+        if(m_internal[i]) {
+            return true;
         }
-
-        return false;
     }
 
-    bool rook(const bcl::board& board, const std::size_t from, const std::size_t to) noexcept {
-        std::size_t difference = detail::absdiff(from, to);
-        std::size_t subtractor = (difference >= board.length) ? board.length : 1;
-
-        assert(from != to);
-        assert(difference < board.length || difference % board.length == 0);
-
-        if(from > to) {
-            while((difference -= subtractor) > 0) {
-                if(board[from - difference]) {
-                    return true;
-                }
-            }
-        }
-
-        else {
-            while((difference -= subtractor) > 0) {
-                if(board[from + difference]) {
-                    return true;
-                }
-            }
-        }
-
-        return false;
-    }
+    return false;
 }
 
-std::optional<bcl::piece::move> bcl::board::pseudolegal(const std::size_t from, const std::size_t to) const noexcept {
+std::optional<bcl::piece::move> bcl::board::castleable(const std::size_t from, const std::size_t to) const noexcept {
     const auto& origin = m_internal[from];
-    const auto& dest = m_internal[to];
 
-    // Some sanity checks.
-    assert(origin.has_value());
-    assert(from != to);
+    // The move generators only ask about empty squares two steps along the king's rank,
+    // so there's no need to check the distance or which rank the king is on.
+    assert(origin.has_value() && origin->variety == piece::type::king);
+    assert(!m_internal[to]);
+
+    std::size_t left = corners[m_color];
+    std::size_t right = corners[m_color + 2];
+    std::size_t index;
+    bool allowed;
+
+    // The valid destinations are 2 squares to the right of the left-most square (queenside),
+    // or 1 square to the left of the right-most square (kingside), depending on color.
+    if(to == left + 2) {
+        allowed = m_rights[origin->hue].queenside;
+        index = left;
+    } else if(to == right - 1) {
+        allowed = m_rights[origin->hue].kingside;
+        index = right;
+    } else {
+        return std::nullopt;
+    }
 
-    index difference = {
-        detail::absdiff(from / length, to / length),
-        detail::absdiff(from % length, to % length)
+    bool castleable = {
+        m_internal[index] && m_internal[index]->variety == piece::type::rook && m_internal[index]->hue == origin->hue &&
+        !this->obstructed(from, index) && allowed
     };
 
-    switch(origin->variety) {
-        case piece::type::pawn: {
-            bool forward = {
-                (origin->hue == piece::color::white && from < to) ||
-                (origin->hue == piece::color::black && from > to)
-            };
-
-            if(!forward) {
-                // Pawns can't move backwards.
-                return std::nullopt;
-            }
-
-            index source = {from / length, from % length};
-
-            bool pushing = {
-                (source.rank == 1 || source.rank == length - 2) &&
-                difference.rank == 2 && difference.file == 0 && !dest
-            };
-
-            if(pushing) {
-                // Pawns can move two squares forward on their first move, assuming a clear path.
-                bool white = (origin->hue == piece::color::white);
-                std::size_t adjacent = (white) ? from + length : from - length;
-                if(!m_internal[adjacent]) {
-                    return piece::move::normal;
-                }
-
-                return std::nullopt;
-            }
-
-            index sink = {to / length, to % length};
-
-            if(difference.rank == 1 && difference.file == 0 && !dest) {
-                // Pawns can always move one square forward if not blocked.
-                // If a pawn has managed to reach the end of the board, it is promoted instead.
-                if(sink.rank == 0 || sink.rank == length - 1) {
-                    return piece::move::promotion;
-                }
-
-                return piece::move::normal;
-            }
-
-            if(difference.rank == 1 && difference.file == 1 && dest) {
-                // Pawns can also diagonally capture if there is a piece present.
-                if(sink.rank == 0 || sink.rank == length - 1) {
-                    return piece::move::promotion;
-                }
-
-                return piece::move::capture;
-            }
-
-            if(const auto& latest = this->latest()) {
-                // En-passant capture is possible only if...
-                // - The last move was a 2-square pawn move.
-                // - The target square is behind the pawn to be captured.
-                // - The attacking pawn is adjacent to the target pawn.
-                bool takable = {
-                    m_internal[latest->to]->variety == piece::type::pawn &&
-                    detail::absdiff(latest->from, latest->to) == length * 2 &&
-                    detail::absdiff(to, latest->to) == length &&
-                    detail::absdiff(from, latest->to) == 1 &&
-                    !(source.file == 0 && sink.file == length - 1) &&
-                    !(source.file == length - 1 && sink.file == 0)
-                };
-
-                if(takable) {
-                    return piece::move::en_passant;
-                }
-            }
-
-            break;
-        }
-
-        case piece::type::knight: {
-            // Knights can move in an L-shape (2 units in one direction, 1 unit in the other).
-            bool allowed = {
-                (difference.rank == 1 && difference.file == 2) ||
-                (difference.rank == 2 && difference.file == 1)
-            };
-
-            if(allowed) {
-                return (dest) ? piece::move::capture : piece::move::normal;
-            }
-
-            break;
-        }
-
-        case piece::type::bishop: {
-            // Make sure the bishop is moving diagonally and not obstructed.
-            if(difference.rank == difference.file && !detail::bishop(*this, from, to)) {
-                return (dest) ? piece::move::capture : piece::move::normal;
-            }
-
-            break;
-        }
-
-        case piece::type::rook: {
-            // Make sure the rook is travelling in a straight, unobstructed line.
-            if((difference.rank == 0 || difference.file == 0) && !detail::rook(*this, from, to)) {
-                return (dest) ? piece::move::capture : piece::move::normal;
-            }
-
-            break;
-        }
-
-        case piece::type::queen: {
-            // If the queen is moving in a diagonal pattern, it must obey bishop movement rules.
-            if(difference.rank == difference.file && !detail::bishop(*this, from, to)) {
-                return (dest) ? piece::move::capture : piece::move::normal;
-            }
-
-            // Otherwise if the queen is moving in a straight line, it must obey rook movement rules.
-            if((difference.rank == 0 || difference.file == 0) && !detail::rook(*this, from, to)) {
-                return (dest) ? piece::move::capture : piece::move::normal;
-            }
-
-            break;
-        }
-
-        case piece::type::king: {
-            // The king can move in any direction (but only for one square).
-            // This is equivalent to ORing the rank and file difference and comparing with 1.
-            if((difference.rank | difference.file) == 1) {
-                return (dest) ? piece::move::capture : piece::move::normal;
-            }
-
-            // The king can also castle.
-            if(difference.rank == 0 && difference.file == 2 && !dest) {
-                std::size_t left = corners[m_color];
-                std::size_t right = corners[m_color + 2];
-                std::size_t index;
-                bool allowed;
-
-                // The valid destinations are 2 squares to the right of the left-most square,
-                // or 1 square to the left of the right-most square (depending on color).
-                if(to == left + 2) {
-                    allowed = m_rights[origin->hue].kingside;
-                    index = left;
-                } else if(to == right - 1) {
-                    allowed = m_rights[origin->hue].queenside;
-                    index = right;
-                } else {
-                    return std::nullopt;
-                }
-
-                bool castleable = {
-                    m_internal[index] && m_internal[index]->variety == piece::type::rook &&
-                    !detail::rook(*this, from, index) && allowed
-                };
-
-                if(castleable) {
-                    return (from < to) ? piece::move::short_castle : piece::move::long_castle;
-                }
-            }
-
-            break;
-        }
+    if(castleable) {
+        return (from < to) ? piece::move::short_castle : piece::move::long_castle;
     }
 
     return std::nullopt;
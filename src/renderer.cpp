@@ -112,7 +112,7 @@ void bcl::renderer::render(const bcl::board& board) noexcept {
 
         // Compute whether the square should be light or dark or highlighted.
         const auto& last = board.latest();
-        bool green = last && (i == last->from || i == last->to);
+        bool green = last && (i == last->from() || i == last->to());
 
         bool dark = {
             (board.length % 2 != 0) ?
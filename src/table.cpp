@@ -0,0 +1,120 @@
+#include "table.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace detail {
+    // The layout of an entry's data, from the lowest bit upwards.
+    constexpr std::uint64_t score_shift = 0;
+    constexpr std::uint64_t move_shift = 32;
+    constexpr std::uint64_t depth_shift = 54;
+    constexpr std::uint64_t bound_shift = 60;
+    constexpr std::uint64_t generation_shift = 62;
+
+    constexpr std::uint64_t move_mask = (std::uint64_t {1} << 22) - 1;
+    constexpr std::uint64_t depth_mask = (std::uint64_t {1} << 6) - 1;
+    constexpr std::uint64_t bound_mask = 0x3;
+    constexpr std::uint64_t generation_mask = 0x3;
+
+    // Returns the number of buckets that fit in a number of bytes. A power of
+    // two is always used, so that a key can be turned into an index with a mask.
+    std::size_t buckets(const std::size_t bytes, const std::size_t size) noexcept {
+        return std::bit_floor(std::max(bytes / size, std::size_t {1}));
+    }
+
+    // Packs a move into 22 bits. No move at all is stored as zero, which can't be a move (the squares would match).
+    std::uint64_t pack(const std::optional<bcl::move> move) noexcept {
+        if(!move) {
+            return 0;
+        }
+
+        return move->from() | (move->to() << 8) |
+            (std::uint64_t {ext::to_underlying(move->kind())} << 16) |
+            (std::uint64_t {ext::to_underlying(move->promotion())} << 19);
+    }
+
+    std::optional<bcl::move> unpack(const std::uint64_t bits) noexcept {
+        if(bits == 0) {
+            return std::nullopt;
+        }
+
+        return bcl::move {
+            static_cast<std::size_t>(bits & 0xFF),
+            static_cast<std::size_t>((bits >> 8) & 0xFF),
+            static_cast<bcl::piece::move>((bits >> 16) & 0x7),
+            static_cast<bcl::piece::type>((bits >> 19) & 0x7)
+        };
+    }
+
+    // Returns the generation of the search that stored some data.
+    std::uint64_t generation(const std::uint64_t data) noexcept {
+        return (data >> generation_shift) & generation_mask;
+    }
+
+    // Returns the depth that some data was searched to.
+    std::uint64_t depth(const std::uint64_t data) noexcept {
+        return (data >> depth_shift) & depth_mask;
+    }
+}
+
+bcl::table::table(const std::size_t bytes) noexcept :
+    m_buckets {std::make_unique<bucket[]>(detail::buckets(bytes, sizeof(bucket)))},
+    m_mask {detail::buckets(bytes, sizeof(bucket)) - 1},
+    m_generation {0} {}
+
+void bcl::table::age(void) noexcept {
+    m_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::optional<bcl::transposition> bcl::table::probe(const zobrist::key key) const noexcept {
+    for(const auto& slot : m_buckets[key & m_mask].entries) {
+        std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+        std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+
+        if((check ^ data) != key) {
+            continue;
+        }
+
+        return transposition {
+            static_cast<double>(std::bit_cast<float>(static_cast<std::uint32_t>(data >> detail::score_shift))),
+            static_cast<std::size_t>(detail::depth(data)),
+            static_cast<bcl::bound>((data >> detail::bound_shift) & detail::bound_mask),
+            detail::unpack((data >> detail::move_shift) & detail::move_mask)
+        };
+    }
+
+    return std::nullopt;
+}
+
+void bcl::table::store(const zobrist::key key, const transposition& t) noexcept {
+    auto& entries = m_buckets[key & m_mask].entries;
+    std::uint64_t generation = m_generation.load(std::memory_order_relaxed) & detail::generation_mask;
+
+    // Scores are material counts (or infinite), so nothing is lost by storing them as floats.
+    auto score = std::bit_cast<std::uint32_t>(static_cast<float>(t.score));
+
+    std::uint64_t data = (std::uint64_t {score} << detail::score_shift) |
+        (detail::pack(t.move) << detail::move_shift) |
+        (std::min(std::uint64_t {t.depth}, detail::depth_mask) << detail::depth_shift) |
+        (std::uint64_t {ext::to_underlying(t.bound)} << detail::bound_shift) |
+        (generation << detail::generation_shift);
+
+    // Entries from earlier searches are worth less than any from this one, and shallow entries less than deep ones.
+    auto worth = [&](const entry& e) {
+        std::uint64_t d = e.data.load(std::memory_order_relaxed);
+        return (detail::generation(d) == generation) ? detail::depth(d) + 1 : 0;
+    };
+
+    auto victim = std::ranges::min_element(entries, {}, worth);
+
+    for(auto it = entries.begin(); it != entries.end(); ++it) {
+        std::uint64_t d = it->data.load(std::memory_order_relaxed);
+        if((it->check.load(std::memory_order_relaxed) ^ d) == key) {
+            victim = it;
+            break;
+        }
+    }
+
+    victim->data.store(data, std::memory_order_relaxed);
+    victim->check.store(key ^ data, std::memory_order_relaxed);
+}
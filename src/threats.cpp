@@ -0,0 +1,289 @@
+#include "geometry.hpp"
+#include "bitboard.hpp"
+#include "pieces.hpp"
+#include "extras.hpp"
+#include "rules.hpp"
+#include "board.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <cassert>
+
+void bcl::board::analyse(void) noexcept {
+    bcl::dispatch(*this, [&](auto policy) {
+        this->analyse<decltype(policy)>(false);
+    });
+}
+
+template<typename R>
+void bcl::board::analyse(const bool incremental) noexcept {
+    // Nothing can be threatened when the rules of chess don't apply.
+    constexpr bool anarchy = std::same_as<R, rules::anarchy>;
+    assert(m_anarchy == anarchy);
+
+    auto us = m_color;
+    auto them = ext::flip(us);
+
+    // A move only changes the contents of a handful of squares: where the piece moved from and to,
+    // the pawn captured en passant, and the rook moved when castling. Lines through a king that
+    // don't pass through one of these are the same as they were before the move.
+    ext::array<std::size_t, 4> touched {};
+    std::size_t changes = 0;
+
+    if(incremental && !anarchy) {
+        const auto& last = m_history.back();
+        std::size_t from = last.move.from();
+        std::size_t to = last.move.to();
+        touched[changes++] = from;
+        touched[changes++] = to;
+
+        if(last.move.kind() == piece::move::en_passant) {
+            touched[changes++] = from - (*m_geometry)[from].file + (*m_geometry)[to].file;
+        } else if(last.move.kind() == piece::move::short_castle || last.move.kind() == piece::move::long_castle) {
+            auto rook = this->castling(last.move);
+            touched[changes++] = rook.from();
+            touched[changes++] = rook.to();
+        }
+    }
+
+    if(m_occupancy) {
+        threats<bitboard> t {};
+
+        if constexpr(anarchy) {
+            m_bitboard_threats.push_back(t);
+            return;
+        }
+
+        const auto& sets = *m_occupancy;
+        const auto& types = sets.types;
+        bitboard occupied = sets.all();
+        bitboard changed = 0;
+
+        for(std::size_t i = 0; i < changes; ++i) {
+            changed |= bitboards::square(touched[i]);
+        }
+
+        if(incremental) {
+            t.pinned = m_bitboard_threats.back().pinned;
+        }
+
+        for(auto hue : {piece::color::white, piece::color::black}) {
+            std::size_t king = m_kings[hue];
+            bitboard enemies = sets.colors[ext::flip(hue)];
+            bitboard diagonals = (types[piece::type::bishop] | types[piece::type::queen]) & enemies;
+            bitboard orthogonals = (types[piece::type::rook] | types[piece::type::queen]) & enemies;
+
+            // The side that just moved can't be in check, and the side to move was only put in check
+            // by a piece landing on a touched square or by a slider revealed behind one.
+            if(hue == us) {
+                bitboard landed = (incremental) ? changed : ~bitboard {0};
+
+                t.checkers = enemies & landed & (
+                    (bitboards::pawn[us][king] & types[piece::type::pawn]) |
+                    (bitboards::knight[king] & types[piece::type::knight]) |
+                    (bitboards::king[king] & types[piece::type::king])
+                );
+            }
+
+            // Both kings keep their pins unless the move touched a line running through them.
+            if(incremental && !(changed & (bitboards::queen(king, 0) | bitboards::square(king)))) {
+                continue;
+            }
+
+            if(hue == us) {
+                t.checkers |= (bitboards::bishop(king, occupied) & diagonals) | (bitboards::rook(king, occupied) & orthogonals);
+            }
+
+            // Enemy sliders lined up with the king (ignoring friendly pieces) pin
+            // a friendly piece if it is the only piece standing in between.
+            bitboard snipers = (bitboards::bishop(king, enemies) & diagonals) | (bitboards::rook(king, enemies) & orthogonals);
+            t.pinned[hue] = 0;
+
+            while(snipers) {
+                bitboard blockers = bitboards::between(king, bitboards::pop(snipers)) & occupied;
+                if(bitboards::count(blockers) == 1) {
+                    t.pinned[hue] |= blockers & sets.colors[hue];
+                }
+            }
+        }
+
+        m_bitboard_threats.push_back(t);
+        return;
+    }
+
+    threats<squareset> t {};
+
+    if constexpr(anarchy) {
+        m_mailbox_threats.push_back(t);
+        return;
+    }
+
+    const auto& grid = *m_geometry;
+
+    if(incremental) {
+        t.pinned = m_mailbox_threats.back().pinned;
+    }
+
+    auto hostile = [&](const std::size_t i, const piece::type type) {
+        const auto& piece = m_internal[i];
+        return piece && piece->hue == them && piece->variety == type;
+    };
+
+    auto detect = [&](const std::span<const std::size_t> squares, const piece::type type) {
+        for(std::size_t i : squares) {
+            if(hostile(i, type)) {
+                t.checkers.set(i);
+            }
+        }
+    };
+
+    // As with bitboards, leaping pieces can only have started giving check by landing on a touched square.
+    if(incremental) {
+        std::size_t king = m_kings[us];
+
+        for(std::size_t i = 0; i < changes; ++i) {
+            auto landed = [&](const std::span<const std::size_t> squares, const piece::type type) {
+                return hostile(touched[i], type) && std::ranges::find(squares, touched[i]) != squares.end();
+            };
+
+            if(landed(grid.pawn(us, king), piece::type::pawn) || landed(grid.knight(king), piece::type::knight)) {
+                t.checkers.set(touched[i]);
+            }
+        }
+    } else {
+        std::size_t king = m_kings[us];
+        detect(grid.pawn(us, king), piece::type::pawn);
+        detect(grid.knight(king), piece::type::knight);
+        detect(grid.king(king), piece::type::king);
+    }
+
+    for(auto hue : {piece::color::white, piece::color::black}) {
+        std::size_t king = m_kings[hue];
+
+        // Only the rays from the king running through a touched square are looked at again,
+        // unless the king moved, in which case none of its old pins can be trusted.
+        ext::array<bool, ext::to_underlying(direction::last) + 1> rays {};
+        rays.fill(!incremental);
+
+        for(std::size_t i = 0; i < changes; ++i) {
+            if(touched[i] == king) {
+                t.pinned[hue].reset();
+                rays.fill(true);
+            } else if(auto heading = grid.heading(king, touched[i])) {
+                rays[*heading] = true;
+            }
+        }
+
+        // Along each ray, an enemy slider either gives check directly or pins the first friendly piece.
+        for(auto d = direction::first; d <= direction::last; d = d + 1) {
+            if(!rays[d]) {
+                continue;
+            }
+
+            std::optional<std::size_t> shield;
+
+            for(std::size_t i : grid.ray(king, d)) {
+                t.pinned[hue].reset(i);
+            }
+
+            for(std::size_t i : grid.ray(king, d)) {
+                const auto& piece = m_internal[i];
+                if(!piece) {
+                    continue;
+                }
+
+                if(piece->hue == hue && !shield) {
+                    shield = i;
+                    continue;
+                }
+
+                if(piece->hue != hue && slides(piece->variety, d)) {
+                    if(shield) {
+                        t.pinned[hue].set(*shield);
+                    } else if(hue == us) {
+                        t.checkers.set(i);
+                    }
+                }
+
+                break;
+            }
+        }
+    }
+
+    m_mailbox_threats.push_back(t);
+}
+
+template void bcl::board::analyse<bcl::rules::standard>(const bool) noexcept;
+template void bcl::board::analyse<bcl::rules::anarchy>(const bool) noexcept;
+
+bool bcl::board::check(void) const noexcept {
+    if(m_occupancy) {
+        return m_bitboard_threats.back().checkers != 0;
+    }
+
+    return m_mailbox_threats.back().checkers.any();
+}
+
+bool bcl::board::attacked(const std::size_t i, const piece::color color, const std::optional<std::size_t> transparent) const noexcept {
+    // Rather than working out everything the attacking color can reach, the square looks outwards
+    // as every type of piece in turn and checks whether it sees an attacker of that type.
+    if(m_occupancy) {
+        const auto& sets = *m_occupancy;
+        const auto& types = sets.types;
+        bitboard occupied = sets.all() & ~((transparent) ? bitboards::square(*transparent) : 0);
+
+        return (sets.colors[color] & (
+            (bitboards::pawn[ext::flip(color)][i] & types[piece::type::pawn]) |
+            (bitboards::knight[i] & types[piece::type::knight]) |
+            (bitboards::king[i] & types[piece::type::king]) |
+            (bitboards::bishop(i, occupied) & (types[piece::type::bishop] | types[piece::type::queen])) |
+            (bitboards::rook(i, occupied) & (types[piece::type::rook] | types[piece::type::queen]))
+        )) != 0;
+    }
+
+    const auto& grid = *m_geometry;
+
+    auto hostile = [&](const std::size_t j, const piece::type type) {
+        const auto& piece = m_internal[j];
+        return piece && piece->hue == color && piece->variety == type;
+    };
+
+    auto sees = [&](const std::span<const std::size_t> squares, const piece::type type) {
+        return std::ranges::any_of(squares, [&](const std::size_t j) { return hostile(j, type); });
+    };
+
+    if(sees(grid.pawn(ext::flip(color), i), piece::type::pawn) || sees(grid.knight(i), piece::type::knight) || sees(grid.king(i), piece::type::king)) {
+        return true;
+    }
+
+    // Along each ray, only the first piece (other than the transparent one) can be attacking.
+    for(auto d = direction::first; d <= direction::last; d = d + 1) {
+        for(std::size_t j : grid.ray(i, d)) {
+            const auto& piece = m_internal[j];
+            if(!piece || j == transparent) {
+                continue;
+            }
+
+            if(piece->hue == color && slides(piece->variety, d)) {
+                return true;
+            }
+
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool bcl::board::pinned(const std::size_t i) const noexcept {
+    const auto& piece = m_internal[i];
+    if(!piece) {
+        return false;
+    }
+
+    if(m_occupancy) {
+        return (m_bitboard_threats.back().pinned[piece->hue] & bitboards::square(i)) != 0;
+    }
+
+    return m_mailbox_threats.back().pinned[piece->hue].test(i);
+}
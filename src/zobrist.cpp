@@ -0,0 +1,77 @@
+#include "geometry.hpp"
+#include "zobrist.hpp"
+#include "pieces.hpp"
+#include "extras.hpp"
+
+#include <cstdint>
+#include <cassert>
+
+namespace detail {
+    constexpr std::size_t pieces = 2 * (ext::to_underlying(bcl::piece::type::last) + 1);
+
+    struct keys {
+        ext::array<ext::array<bcl::zobrist::key, bcl::constants::maximum_squares>, pieces> placement;
+        ext::array<bcl::zobrist::key, 16> castling;
+        ext::array<bcl::zobrist::key, bcl::constants::maximum_length> passant;
+        bcl::zobrist::key turn;
+    };
+
+    // Fills the key tables using SplitMix64, which is cheap to evaluate at compile time.
+    consteval keys generate(void) noexcept {
+        keys k {};
+        std::uint64_t state = 0xB0C1C10D;
+
+        auto next = [&]() {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        };
+
+        for(auto& table : k.placement) {
+            for(auto& key : table) {
+                key = next();
+            }
+        }
+
+        // The key for a set of castling rights is the combination of the key for each right,
+        // so that a set of rights can be looked up in one go.
+        ext::array<bcl::zobrist::key, 4> rights {};
+        for(auto& key : rights) {
+            key = next();
+        }
+
+        for(std::size_t i = 0; i < k.castling.size(); ++i) {
+            for(std::size_t bit = 0; bit < rights.size(); ++bit) {
+                k.castling[i] ^= (i & (std::size_t {1} << bit)) ? rights[bit] : 0;
+            }
+        }
+
+        for(auto& key : k.passant) {
+            key = next();
+        }
+
+        k.turn = next();
+        return k;
+    }
+
+    constexpr keys tables = generate();
+}
+
+bcl::zobrist::key bcl::zobrist::placement(const piece p, const std::size_t i) noexcept {
+    assert(i < constants::maximum_squares);
+    std::size_t index = (std::size_t {ext::to_underlying(p.hue)} * (ext::to_underlying(piece::type::last) + 1)) + ext::to_underlying(p.variety);
+    return detail::tables.placement[index][i];
+}
+
+bcl::zobrist::key bcl::zobrist::castling(const std::size_t rights) noexcept {
+    return detail::tables.castling[rights];
+}
+
+bcl::zobrist::key bcl::zobrist::passant(const std::size_t file) noexcept {
+    return detail::tables.passant[file];
+}
+
+bcl::zobrist::key bcl::zobrist::turn(void) noexcept {
+    return detail::tables.turn;
+}
@@ -0,0 +1,191 @@
+#include "board.hpp"
+
+#include <argparse/argparse.hpp>
+#include <fmt/core.h>
+#include <string_view>
+#include <stdexcept>
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <cstddef>
+#include <cstdlib>
+#include <utility>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <new>
+
+namespace detail {
+    // The number of times the heap has been allocated from, so that move generation can be checked for allocations.
+    std::atomic<std::size_t> allocations {0};
+
+    // A position from an EPD file, along with the number of positions expected after each depth.
+    struct entry {
+        std::string fen;
+        std::vector<std::pair<std::size_t, std::size_t>> expected;
+    };
+
+    // Trims whitespace from either end of a string.
+    std::string_view trim(std::string_view string) noexcept {
+        auto first = string.find_first_not_of(" \t\r");
+        auto last = string.find_last_not_of(" \t\r");
+        return (first == std::string_view::npos) ? std::string_view {} : string.substr(first, last - first + 1);
+    }
+
+    // Parses a line in the form "<FEN> ;D1 <count> ;D2 <count> ...".
+    entry parse(const std::string_view line) {
+        entry e {};
+        auto separator = line.find(';');
+        e.fen = trim(line.substr(0, separator));
+
+        while(separator != std::string_view::npos) {
+            auto next = line.find(';', separator + 1);
+            auto field = trim(line.substr(separator + 1, (next == std::string_view::npos) ? next : next - separator - 1));
+            auto space = field.find(' ');
+            separator = next;
+
+            if(field.size() < 2 || field[0] != 'D' || space == std::string_view::npos) {
+                throw std::runtime_error(fmt::format("malformed field \"{}\"", field));
+            }
+
+            std::size_t depth = 0;
+            std::size_t count = 0;
+            auto digits = trim(field.substr(space + 1));
+            auto d = std::from_chars(field.data() + 1, field.data() + space, depth);
+            auto c = std::from_chars(digits.data(), digits.data() + digits.size(), count);
+
+            if(d.ec != std::errc {} || c.ec != std::errc {}) {
+                throw std::runtime_error(fmt::format("malformed field \"{}\"", field));
+            }
+
+            e.expected.emplace_back(depth, count);
+        }
+
+        return e;
+    }
+}
+
+// Every allocation made by the program goes through here and is counted.
+void* operator new(const std::size_t size) {
+    ++detail::allocations;
+
+    if(void* pointer = std::malloc((size) ? size : 1)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::size_t) noexcept {
+    std::free(pointer);
+}
+
+int main(int argc, char** argv) {
+    // Runs perft on every position in an EPD file and compares the results against the expected counts.
+    argparse::ArgumentParser program("perft");
+
+    program.add_argument("file")
+        .help("the EPD file of positions to test");
+
+    program.add_argument("-t", "--threads")
+        .required()
+        .help("the number of threads to run perft on")
+        .scan<'u', std::size_t>()
+        .default_value(std::size_t {1});
+
+    program.add_argument("-d", "--depth")
+        .required()
+        .help("skip any counts deeper than this")
+        .scan<'u', std::size_t>()
+        .default_value(std::size_t {6});
+
+    // Let this throw if there are any runtime errors.
+    program.parse_args(argc, argv);
+
+    auto path = program.get<std::string>("file");
+    auto threads = program.get<std::size_t>("threads");
+    auto limit = program.get<std::size_t>("depth");
+
+    std::ifstream file(path);
+    if(!file) {
+        fmt::print("[perft] couldn't open {}.\n", path);
+        return 1;
+    }
+
+    std::size_t passed = 0;
+    std::size_t failed = 0;
+    std::string line;
+
+    while(std::getline(file, line)) {
+        // Blank lines and lines starting with # are ignored.
+        auto content = detail::trim(line);
+        if(content.empty() || content.front() == '#') {
+            continue;
+        }
+
+        try {
+            auto entry = detail::parse(content);
+
+            // The size of the board is implied by the number of ranks in the FEN string.
+            auto placement = std::string_view {entry.fen}.substr(0, entry.fen.find(' '));
+            auto length = static_cast<std::size_t>(std::ranges::count(placement, '/')) + 1;
+
+            bcl::board board(length, false);
+            board.load(entry.fen);
+            fmt::print("[perft] {}\n", entry.fen);
+
+            for(const auto& [depth, expected] : entry.expected) {
+                if(depth > limit) {
+                    continue;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                auto count = board.positions(depth, threads);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                bool success = (count == expected);
+                auto rate = static_cast<double>(count) / std::max(elapsed.count(), 1e-9);
+
+                if(success) {
+                    ++passed;
+                } else {
+                    ++failed;
+                }
+
+                fmt::print(
+                    "[perft]   depth {}: {} ({} expected) in {:.3f}s, {:.0f} nodes/s ... {}\n",
+                    depth, count, expected, elapsed.count(), rate, (success) ? "pass" : "FAIL"
+                );
+            }
+
+            // Once the board's history has grown to fit a search, walking the tree again shouldn't touch the heap.
+            constexpr std::size_t depth = 2;
+            board.positions(depth);
+
+            std::size_t before = detail::allocations;
+            board.positions(depth);
+            std::size_t allocated = detail::allocations - before;
+
+            if(allocated == 0) {
+                ++passed;
+            } else {
+                ++failed;
+            }
+
+            fmt::print("[perft]   depth {}: {} heap allocations ... {}\n", depth, allocated, (allocated == 0) ? "pass" : "FAIL");
+        }
+
+        catch(const std::exception& error) {
+            fmt::print("[perft] couldn't run \"{}\": {}\n", content, error.what());
+            ++failed;
+        }
+    }
+
+    fmt::print("[perft] {} passed, {} failed.\n", passed, failed);
+    return (failed == 0) ? 0 : 1;
+}